@@ -65,6 +65,13 @@ public:
 		ioctl(s, FIONREAD, &count);
 		return count;
 	}
+	virtual bool do_closed() override
+	{
+		char c;
+
+		// a readable socket without data reached its end
+		return recv(s, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0;
+	}
 	virtual void do_flush() override
 	{
 		if (ptr - buffer) {
@@ -35,6 +35,19 @@ public:
 			return do_in_available();
 		}
 	}
+	/**
+	  Returns whether the peer closed the connection. Is polled while no input is available.
+	 */
+	bool closed()
+	{
+		if (_mutex) {
+			std::lock_guard<std::mutex> lock(*_mutex);
+
+			return do_closed();
+		} else {
+			return do_closed();
+		}
+	}
 	size_type read(void* buffer, size_type at_least, size_type at_most)
 	{
 		if (_mutex) {
@@ -71,6 +84,14 @@ protected:
 	virtual size_type do_in_available()                                            = 0;
 	virtual size_type do_read(void* buffer, size_type at_least, size_type at_most) = 0;
 	virtual size_type do_write(const void* buffer, size_type size)                 = 0;
+	/**
+	  Checks whether the peer closed the connection without blocking. Connections that cannot tell return `false`;
+	  their end is only noticed when reading fails.
+	 */
+	virtual bool do_closed()
+	{
+		return false;
+	}
 
 private:
 	std::mutex* _mutex;
@@ -0,0 +1,113 @@
+#ifndef FAST_CGI_DETAIL_CANCELLATION_HPP_
+#define FAST_CGI_DETAIL_CANCELLATION_HPP_
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+namespace fast_cgi {
+namespace detail {
+
+/**
+  The cancellation state of a request. The flag can be polled without locking; a callback is called once when the
+  request is cancelled.
+ */
+class cancellation
+{
+public:
+	typedef std::function<void()> callback_type;
+
+	cancellation() noexcept : _cancelled(false)
+	{}
+	bool cancelled() const noexcept
+	{
+		return _cancelled.load(std::memory_order_acquire);
+	}
+	/**
+	  Sets the callback. If already cancelled, the callback is called immediately. Waits until a running callback
+	  returned, so the previous callback is never called after this function returned.
+
+	  @param callback the callback; may be empty
+	 */
+	void set_callback(callback_type callback)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (_cancelled.load(std::memory_order_relaxed)) {
+			if (callback) {
+				callback();
+			}
+
+			_callback = nullptr;
+		} else {
+			_callback = std::move(callback);
+		}
+	}
+	/**
+	  Sets the flag and calls the callback. The callback is called while locked and must not set a new callback.
+
+	  @returns `false` if already cancelled
+	 */
+	bool cancel()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (_cancelled.load(std::memory_order_relaxed)) {
+			return false;
+		}
+
+		_cancelled.store(true, std::memory_order_release);
+
+		if (_callback) {
+			auto callback = std::move(_callback);
+
+			_callback = nullptr;
+
+			callback();
+		}
+
+		return true;
+	}
+	/**
+	  Calls the function unless cancelled. A concurrent cancellation waits until the function returned, so everything
+	  that runs after `cancel()` sees its effects.
+
+	  @param function the function; must not cancel
+	  @returns `false` if already cancelled
+	 */
+	template<typename Function>
+	bool unless_cancelled(Function function)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (_cancelled.load(std::memory_order_relaxed)) {
+			return false;
+		}
+
+		function();
+
+		return true;
+	}
+	/**
+	  Clears the flag and the callback. Must not be called while the request is in use.
+	 */
+	void reset() noexcept
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_cancelled.store(false, std::memory_order_relaxed);
+		_callback = nullptr;
+	}
+
+private:
+	std::atomic_bool _cancelled;
+	/** guards the callback and serializes it with `cancel()` */
+	std::mutex _mutex;
+	callback_type _callback;
+};
+
+} // namespace detail
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
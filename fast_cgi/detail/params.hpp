@@ -2,20 +2,144 @@
 #define FAST_CGI_DETAIL_PARAMS_HPP_
 
 #include "../io/reader.hpp"
+#include "../memory/arena.hpp"
+#include "../string_view.hpp"
 #include "record.hpp"
 
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace fast_cgi {
 namespace detail {
 
+/**
+  The parameters of a request. The raw name-value pairs are kept as one contiguous block, which is indexed with a single
+  pass over the lengths; names and values are views into this block. The index is only sorted when a parameter other
+  than a standard variable is looked up or the parameters are iterated. The block and the index are allocated in the
+  arena of the request. Copies are allocated on the heap.
+
+  The standard CGI variables are recognized while decoding and additionally stored in fixed slots, so that they can be
+  accessed without searching.
+ */
 class params
 {
 public:
+	typedef std::pair<string_view, string_view> value_type;
 	typedef std::map<std::string, std::string> map_type;
 
+	/** the variables with a fixed slot */
+	enum class VARIABLE
+	{
+		auth_type,
+		content_length,
+		content_type,
+		document_root,
+		document_uri,
+		gateway_interface,
+		https,
+		http_accept,
+		http_accept_encoding,
+		http_accept_language,
+		http_authorization,
+		http_cookie,
+		http_host,
+		http_referer,
+		http_user_agent,
+		path_info,
+		path_translated,
+		query_string,
+		remote_addr,
+		remote_host,
+		remote_port,
+		remote_user,
+		request_method,
+		request_scheme,
+		request_uri,
+		script_filename,
+		script_name,
+		server_addr,
+		server_name,
+		server_port,
+		server_protocol,
+		server_software,
+		fcgi_data_length,
+	};
+
+	enum class METHOD
+	{
+		UNKNOWN,
+		GET,
+		HEAD,
+		POST,
+		PUT,
+		DELETE,
+		CONNECT,
+		OPTIONS,
+		TRACE,
+		PATCH
+	};
+
+	constexpr static std::size_t variable_count = static_cast<std::size_t>(VARIABLE::fcgi_data_length) + 1;
+
+	class const_iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef params::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const value_type* pointer;
+		typedef const value_type& reference;
+
+		reference operator*() const noexcept
+		{
+			return _value;
+		}
+		pointer operator->() const noexcept
+		{
+			return &_value;
+		}
+		const_iterator& operator++() noexcept
+		{
+			_value = _params->_pair(++_index);
+
+			return *this;
+		}
+		const_iterator operator++(int) noexcept
+		{
+			auto copy = *this;
+
+			++*this;
+
+			return copy;
+		}
+		bool operator==(const const_iterator& other) const noexcept
+		{
+			return _index == other._index;
+		}
+		bool operator!=(const const_iterator& other) const noexcept
+		{
+			return _index != other._index;
+		}
+
+	private:
+		friend params;
+
+		const params* _params;
+		std::size_t _index;
+		value_type _value;
+
+		const_iterator(const params* params, std::size_t index) noexcept
+		    : _params(params), _index(index), _value(params->_pair(index))
+		{}
+	};
+
 	constexpr static auto request_uri     = "REQUEST_URI";
 	constexpr static auto query_string    = "QUERY_STRING";
 	constexpr static auto content_length  = "CONTENT_LENGTH";
@@ -24,21 +148,137 @@ public:
 	constexpr static auto document_root   = "DOCUMENT_ROOT";
 	constexpr static auto remote_addr     = "REMOTE_ADDR";
 	constexpr static auto remote_port     = "REMOTE_PORT";
-	constexpr static auto script_filename = "SCRIPTE_FILENAME";
+	constexpr static auto script_filename = "SCRIPT_FILENAME";
 	constexpr static auto http_host       = "HTTP_HOST";
 	constexpr static auto request_method  = "REQUEST_METHOD";
+	constexpr static auto accept_encoding = "HTTP_ACCEPT_ENCODING";
+
+	params() noexcept;
+	const_iterator begin() const noexcept;
+	const_iterator end() const noexcept;
+	std::size_t size() const noexcept;
+	bool has(string_view key) const noexcept;
+	/**
+	  Returns the value of the parameter. The value stays valid until the request ends.
+
+	  @param key the name of the parameter
+	  @returns the value
+	  @throws std::out_of_range if the parameter does not exist
+	 */
+	string_view operator[](string_view key) const;
+	bool has(VARIABLE variable) const noexcept;
+	/**
+	  Returns the value of a standard variable.
+
+	  @param variable the variable
+	  @returns the value or an empty view if the variable was not sent
+	 */
+	string_view get(VARIABLE variable) const noexcept;
+	/**
+	  Returns the parsed `CONTENT_LENGTH`.
+
+	  @returns the length or `0` if it is missing or invalid
+	 */
+	std::uint64_t content_size() const noexcept;
+	/**
+	  Returns the parsed `FCGI_DATA_LENGTH` of filters.
 
-	map_type::const_iterator begin() const;
-	map_type::const_iterator end() const;
-	bool has(const std::string& key) const;
-	const std::string& operator[](const std::string& key) const;
+	  @returns the length or `0` if it is missing or invalid
+	 */
+	std::uint64_t data_size() const noexcept;
+	/**
+	  Returns the parsed `REQUEST_METHOD`.
+
+	  @returns the method or `METHOD::UNKNOWN` if it is missing or not a standard method
+	 */
+	METHOD method() const noexcept;
+	/**
+	  Returns an HTTP request header. The name is compared case-insensitively and `-` matches `_`, so `user-agent`
+	  returns the value of `HTTP_USER_AGENT`. `Content-Type` and `Content-Length` return the CGI variables.
+
+	  @param name the name of the header
+	  @returns the value or an empty view if the header was not sent
+	 */
+	string_view header(string_view name) const noexcept;
+	bool has_header(string_view name) const noexcept;
+	/**
+	  Returns the value of a cookie of `HTTP_COOKIE`. The cookies are indexed on the first call. If a name occurs
+	  multiple times, the first value is returned.
+
+	  @param name the case-sensitive name of the cookie
+	  @returns the value without quotes or an empty view if the cookie was not sent
+	 */
+	string_view cookie(string_view name) const;
+	bool has_cookie(string_view name) const;
+	/**
+	  Copies all parameters into a map.
+	 */
+	map_type to_map() const;
 
 private:
 	friend class request_manager;
 
-	map_type _parameters;
+	struct entry
+	{
+		std::uint32_t name;
+		std::uint32_t name_length;
+		std::uint32_t value;
+		std::uint32_t value_length;
+	};
+
+	/** the raw name-value pairs */
+	std::vector<char, memory::arena_allocator<char>> _data;
+	/** in the order of the block until sorted by name */
+	mutable std::vector<entry, memory::arena_allocator<entry>> _index;
+	mutable bool _sorted;
+	/** the entries of the standard variables; the name length is `0` if the variable was not sent */
+	std::array<entry, variable_count> _slots;
+	std::uint64_t _content_size;
+	std::uint64_t _data_size;
+	METHOD _method;
+	/** the `HTTP_*` variables in an open addressing table; the name length is `0` for empty buckets */
+	std::vector<entry, memory::arena_allocator<entry>> _headers;
+	/** sorted by name */
+	mutable std::vector<entry, memory::arena_allocator<entry>> _cookies;
+	mutable bool _cookies_indexed;
+
+	const entry* _find(string_view key) const noexcept;
+	value_type _pair(std::size_t index) const noexcept;
+	/**
+	  Reads all parameters. The block and the index are allocated in the arena. The block is sized by the records of
+	  the stream that arrived so far, so it usually does not grow.
 
-	void _read_parameters(io::reader& reader);
+	  @param[in] reader the reader of the parameter stream
+	  @param[in] arena the arena of the request
+	  @param[in] stream_size the sum of the lengths of the parameter records received so far
+	 */
+	void _read_parameters(io::reader& reader, memory::arena& arena, const std::atomic<std::size_t>& stream_size);
+	/**
+	  Indexes the raw block and fills the slots of the standard variables.
+	 */
+	void _index_parameters();
+	/**
+	  Builds the header table from the index.
+	 */
+	void _index_headers();
+	/**
+	  Splits `HTTP_COOKIE`, if not already done.
+	 */
+	void _index_cookies() const;
+	const entry* _find_header(string_view name) const noexcept;
+	const entry* _find_cookie(string_view name) const;
+	/**
+	  Sorts the index by name and removes duplicate names, if not already done.
+	 */
+	void _sort() const noexcept;
+	/**
+	  Parses the typed values of the standard variables.
+	 */
+	void _parse_variables() noexcept;
+	/**
+	  Removes all parameters. This must be called before the arena is reset.
+	 */
+	void _clear() noexcept;
 };
 
 } // namespace detail
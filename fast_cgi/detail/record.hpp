@@ -3,10 +3,13 @@
 
 #include "../io/output_manager.hpp"
 #include "../io/reader.hpp"
+#include "../memory/buffer_manager.hpp"
 #include "config.hpp"
 
 #include <functional>
+#include <memory>
 #include <ostream>
+#include <utility>
 
 namespace fast_cgi {
 namespace detail {
@@ -190,6 +193,10 @@ struct stdout_stream
 {
 	const void* const content;
 	const double_type content_size;
+	/** keeps the content alive until the record was written */
+	const std::shared_ptr<const void> owner;
+	/** the page holding the content */
+	const memory::page_handle page;
 
 	void write(io::writer& writer) const
 	{
@@ -209,6 +216,8 @@ struct stderr_stream
 {
 	const void* const content;
 	const double_type content_size;
+	/** the page holding the content */
+	const memory::page_handle page;
 
 	void write(io::writer& writer) const
 	{
@@ -224,6 +233,26 @@ struct stderr_stream
 	}
 };
 
+/**
+  Returns whether the record may be discarded when its request is aborted. Only the content of the streams may be
+  discarded; their terminators and the end of the request are always written.
+ */
+template<typename T>
+inline bool discardable(const T&) noexcept
+{
+	return false;
+}
+
+inline bool discardable(const stdout_stream& stream) noexcept
+{
+	return stream.content_size > 0;
+}
+
+inline bool discardable(const stderr_stream& stream) noexcept
+{
+	return stream.content_size > 0;
+}
+
 struct record
 {
 	constexpr static auto default_padding_boundary = 8;
@@ -247,10 +276,9 @@ struct record
 		return { version, type, request_id, content_length, padding_length };
 	}
 	template<typename T>
-	static std::shared_ptr<std::atomic_bool> write(VERSION version, double_type request_id,
-	                                               io::output_manager& output_manager, const T& data)
+	static void write(VERSION version, double_type request_id, io::output_manager& output_manager, const T& data)
 	{
-		return output_manager.add([version, request_id, data](io::writer& writer) {
+		auto task = [version, request_id, data](io::writer& writer) {
 			double_type size    = data.size();
 			single_type padding = size % default_padding_boundary;
 
@@ -270,7 +298,9 @@ struct record
 
 				writer.write(buf, padding);
 			}
-		});
+		};
+
+		output_manager.add(std::move(task), discardable(data) ? request_id : double_type(0));
 	}
 };
 
@@ -2,37 +2,130 @@
 #define FAST_CGI_DETAIL_REQUEST_HPP_
 
 #include "../io/output_manager.hpp"
+#include "../memory/arena.hpp"
 #include "../memory/buffer.hpp"
+#include "cancellation.hpp"
 #include "params.hpp"
 #include "record.hpp"
 
 #include <atomic>
+#include <initializer_list>
+#include <limits>
 #include <memory>
-#include <thread>
 
 namespace fast_cgi {
 namespace detail {
 
+/**
+  The state of a single request. Requests are pooled by the request manager and reused with `reset()`.
+ */
 struct request
 {
-	const detail::double_type id;
-	const detail::ROLE role_type;
-	std::thread handler_thread;
+	constexpr static std::size_t max_buffer_size = 99999;
+	/** the maximum amount of unread bytes of each stream of a filter */
+	constexpr static std::size_t filter_capacity = 262144;
+
+	detail::double_type id;
+	detail::ROLE role_type;
 	std::atomic_bool finished;
+	/** holds the parameters and the role; only used by the handler thread */
+	memory::arena arena;
 	class params params;
+	/** the stream buffers are only created if the role receives the stream */
 	std::shared_ptr<memory::buffer> params_buffer;
+	/** the sum of the lengths of the received parameter records */
+	std::atomic<std::size_t> params_size;
 	std::shared_ptr<memory::buffer> input_buffer;
 	std::shared_ptr<memory::buffer> data_buffer;
 	std::shared_ptr<io::output_manager> output_manager;
-	std::atomic_bool cancelled;
-	const bool close_connection;
-
-	request(detail::double_type id, detail::ROLE role_type, std::shared_ptr<io::output_manager> output_manager,
-	        bool close_connection, std::shared_ptr<memory::allocator> allocator)
-	    : id(id), role_type(role_type), finished(false), output_manager(std::move(output_manager)),
-	      params_buffer(new memory::buffer(allocator, 99999)), input_buffer(new memory::buffer(allocator, 99999)),
-	      data_buffer(new memory::buffer(allocator, 99999)), cancelled(false), close_connection(close_connection)
+	detail::cancellation cancellation;
+	bool close_connection;
+	/** whether the parameters were already read by the connection thread */
+	bool params_ready;
+
+	/**
+	  Creates a new request.
+
+	  @param params_allocator the allocator of the arena and the parameter stream
+	  @param input_allocator the allocator of the stdin and data streams
+	 */
+	request(std::shared_ptr<memory::allocator> params_allocator, std::shared_ptr<memory::allocator> input_allocator)
+	    : id(0), role_type(detail::ROLE::FCGI_RESPONDER), finished(false), arena(params_allocator), params_size(0),
+	      close_connection(false), params_ready(false), _params_allocator(std::move(params_allocator)),
+	      _input_allocator(std::move(input_allocator))
 	{}
+	/**
+	  Prepares this request for a new request id. Must not be called while the request is in use.
+
+	  @param id the request id
+	  @param role_type the requested role
+	  @param output_manager the output manager of the connection
+	  @param close_connection whether the connection is closed after this request
+	 */
+	void reset(detail::double_type id, detail::ROLE role_type, std::shared_ptr<io::output_manager> output_manager,
+	           bool close_connection)
+	{
+		this->id               = id;
+		this->role_type        = role_type;
+		this->output_manager   = std::move(output_manager);
+		this->close_connection = close_connection;
+		this->params_ready     = false;
+
+		finished.store(false, std::memory_order_relaxed);
+		params_size.store(0, std::memory_order_relaxed);
+		cancellation.reset();
+
+		_prepare(params_buffer, _params_allocator, true);
+		_prepare(input_buffer, _input_allocator,
+		         role_type == detail::ROLE::FCGI_RESPONDER || role_type == detail::ROLE::FCGI_FILTER);
+		_prepare(data_buffer, _input_allocator, role_type == detail::ROLE::FCGI_FILTER);
+
+		// a filter reads both streams while they arrive; the capacity bounds them until their sizes are known
+		if (role_type == detail::ROLE::FCGI_FILTER) {
+			for (auto buffer : { input_buffer.get(), data_buffer.get() }) {
+				buffer->set_max(std::numeric_limits<std::size_t>::max());
+				buffer->set_capacity(filter_capacity);
+			}
+		} else if (input_buffer) {
+			input_buffer->set_capacity(std::numeric_limits<std::size_t>::max());
+		}
+	}
+	/**
+	  Cancels this request. The cancellation callback of the role is called and blocked reads of the streams are
+	  interrupted; everything the web server still sends for the streams is skipped.
+
+	  @returns `false` if the request was already cancelled
+	 */
+	bool cancel()
+	{
+		if (!cancellation.cancel()) {
+			return false;
+		}
+
+		for (auto buffer : { params_buffer.get(), input_buffer.get(), data_buffer.get() }) {
+			if (buffer) {
+				buffer->interrupt_all_waiting();
+			}
+		}
+
+		return true;
+	}
+
+private:
+	std::shared_ptr<memory::allocator> _params_allocator;
+	std::shared_ptr<memory::allocator> _input_allocator;
+
+	void _prepare(std::shared_ptr<memory::buffer>& buffer, const std::shared_ptr<memory::allocator>& allocator,
+	              bool required)
+	{
+		if (!required) {
+			buffer.reset();
+		} else if (buffer) {
+			buffer->reset(max_buffer_size);
+		} else {
+			buffer = std::make_shared<memory::buffer>(allocator, std::size_t(max_buffer_size));
+		}
+	}
 };
 
 } // namespace detail
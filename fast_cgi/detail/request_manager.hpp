@@ -1,17 +1,27 @@
 #ifndef FAST_CGI_DETAIL_REQUEST_MANAGER_HPP_
 #define FAST_CGI_DETAIL_REQUEST_MANAGER_HPP_
 
+#include "../io/byte_stream.hpp"
+#include "../io/compressor.hpp"
 #include "../io/output_manager.hpp"
 #include "../io/reader.hpp"
 #include "../memory/allocator.hpp"
+#include "../memory/governor.hpp"
+#include "../response_cache.hpp"
 #include "../role.hpp"
+#include "cancellation.hpp"
 #include "record.hpp"
 #include "request.hpp"
+#include "request_table.hpp"
 
 #include <array>
 #include <atomic>
-#include <map>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace fast_cgi {
 namespace detail {
@@ -20,30 +30,118 @@ class request_manager
 {
 public:
 	typedef double_type id_type;
+	typedef std::function<role_pointer(memory::arena*)> role_factory_type;
 
 	request_manager(std::shared_ptr<memory::allocator> allocator, std::shared_ptr<io::reader> reader,
-	                std::array<std::function<std::unique_ptr<role>()>, 3> role_factories);
+	                std::array<role_factory_type, 3> role_factories, int compression_level,
+	                std::shared_ptr<response_cache> response_cache, std::shared_ptr<class response_cache> authorizer_cache,
+	                std::shared_ptr<memory::governor> governor);
 	~request_manager();
 	bool should_terminate_connection() const;
 	bool handle_request(std::shared_ptr<io::output_manager> output_manager, struct record record);
 
 private:
-	typedef std::map<id_type, std::shared_ptr<request>> requests_type;
+	/** the maximum amount of finished requests kept for reuse */
+	constexpr static std::size_t max_pool_size = 8;
 
 	std::atomic_bool _terminate_connection;
-	requests_type _requests;
+	int _compression_level;
+	/** guards the active requests and the pool */
+	mutable std::mutex _mutex;
+	std::condition_variable _idle;
+	/** the amount of running handler threads */
+	std::size_t _active;
+	request_table _requests;
+	/** the size of `_requests`; can be read without locking */
+	std::atomic<std::size_t> _open_requests;
+	std::vector<std::shared_ptr<request>> _pool;
 	std::shared_ptr<memory::allocator> _allocator;
+	/** accounts the parameters and the arena */
+	std::shared_ptr<memory::allocator> _params_allocator;
+	/** accounts the stdin and data streams */
+	std::shared_ptr<memory::allocator> _input_allocator;
 	std::shared_ptr<io::reader> _reader;
-	std::array<std::function<std::unique_ptr<role>()>, 3> _role_factories;
+	std::array<role_factory_type, 3> _role_factories;
+	std::shared_ptr<response_cache> _response_cache;
+	std::shared_ptr<response_cache> _authorizer_cache;
+	std::shared_ptr<memory::governor> _governor;
 
 	/**
-	  Forwards *length* bytes to *buffer* read by *reader*. If *length* is zero the buffer is closed.
+	  Forwards *length* bytes to *buffer* read by *reader*. If *length* is zero the buffer is closed. Waits while the
+	  buffer is at its capacity unless the role is blocked reading the other stream.
 
 	  @param length the length of the forward content
-	  @param[in] buffer the buffer
+	  @param[in] buffer the buffer; if `nullptr` the content is skipped
+	  @param[in] other the other input stream of the role; may be `nullptr`
 	 */
-	void _forward_to_buffer(detail::double_type length, memory::buffer& buffer);
-	void _request_hanlder(std::unique_ptr<role> role, std::shared_ptr<request> request);
+	void _forward_to_buffer(detail::double_type length, memory::buffer* buffer, memory::buffer* other = nullptr);
+	void _request_hanlder(role_factory_type factory, std::shared_ptr<request> request);
+	/**
+	  Launches the handler thread of the request.
+	 */
+	void _launch(const std::shared_ptr<request>& request);
+	/**
+	  Returns whether the handler thread of the request is launched after its parameters arrived.
+	 */
+	bool _deferred(const request& request) const noexcept;
+	/**
+	  Reads the complete parameters of a deferred request and answers it from the cache or launches its handler
+	  thread.
+	 */
+	void _lookup(const std::shared_ptr<request>& request);
+	/**
+	  Negotiates the content encoding of the output of the request.
+	 */
+	io::compressor::encoding _encoding(const request& request) const;
+	/**
+	  Returns the cache of the request and its key.
+
+	  @returns the cache or `nullptr` if the output of the request is not cached
+	 */
+	response_cache* _cache_of(const request& request, io::compressor::encoding encoding, std::string& key) const;
+	/**
+	  Cancels the request and discards its queued output.
+	 */
+	static void _abort(request& request);
+	/**
+	  Finishes all streams of the request and ends it. The request is returned to the pool.
+
+	  @param request the request
+	  @param status the application status code
+	 */
+	void _end_request(const std::shared_ptr<request>& request, quadruple_type status);
+	/**
+	  Returns a finished request to the pool.
+	 */
+	void _release(const std::shared_ptr<request>& request);
+	/**
+	  Takes a request from the pool or creates a new one.
+	 */
+	std::shared_ptr<request> _acquire();
+	/**
+	  Writes a cached response as the output of the request.
+	 */
+	static void _replay(request& request, std::shared_ptr<const response_cache::entry> entry);
+	/**
+	  Frames the content into stdout records without copying it.
+
+	  @param request the request
+	  @param data the content
+	  @param size the size of the content
+	  @param owner keeps the content alive until the last record was written
+	 */
+	static void _write_owned(request& request, const void* data, std::size_t size, std::shared_ptr<const void> owner);
+	static role::status_code_type _run_role(role& role, class params& params, memory::arena& arena,
+	                                        io::byte_ostream& output, io::byte_ostream& error,
+	                                        cancellation& cancellation);
+	/**
+	  Executes the role of a stale cached response without a request and updates the cache with its output. The pages
+	  are taken from the output manager of the connection, which is kept alive until the revalidation finished.
+	 */
+	static void _revalidate(std::shared_ptr<response_cache> cache, std::string key, role_factory_type factory,
+	                        class params params, std::shared_ptr<memory::allocator> allocator,
+	                        std::shared_ptr<io::output_manager> output_manager, io::compressor::encoding encoding,
+	                        int compression_level);
 	void _begin_request(std::shared_ptr<io::output_manager> output_manager, struct record record);
 };
 
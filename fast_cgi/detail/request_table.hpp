@@ -0,0 +1,183 @@
+#ifndef FAST_CGI_DETAIL_REQUEST_TABLE_HPP_
+#define FAST_CGI_DETAIL_REQUEST_TABLE_HPP_
+
+#include "config.hpp"
+#include "request.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace fast_cgi {
+namespace detail {
+
+/**
+  The active requests of a connection keyed by their id. Web servers multiplex only a few requests over a connection,
+  so the requests are stored in a small open addressing table that grows when it is half full. The table is not
+  synchronized.
+ */
+class request_table
+{
+public:
+	typedef std::shared_ptr<request> value_type;
+
+	constexpr static std::size_t initial_size = 8;
+
+	request_table() : _slots(initial_size), _size(0)
+	{}
+	/**
+	  Returns the request with the id.
+
+	  @param id the request id
+	  @returns the request or `nullptr`
+	 */
+	const value_type& find(double_type id) const noexcept
+	{
+		static const value_type none;
+
+		for (auto i = _index(id);; i = _next(i)) {
+			auto& slot = _slots[i];
+
+			if (!slot.request) {
+				return none;
+			} else if (slot.id == id) {
+				return slot.request;
+			}
+		}
+	}
+	/**
+	  Adds a request. An existing request with the same id is replaced.
+
+	  @param id the request id
+	  @param request the request; must not be `nullptr`
+	 */
+	void insert(double_type id, value_type request)
+	{
+		if ((_size + 1) * 2 > _slots.size()) {
+			_grow();
+		}
+
+		for (auto i = _index(id);; i = _next(i)) {
+			auto& slot = _slots[i];
+
+			if (!slot.request) {
+				++_size;
+			} else if (slot.id != id) {
+				continue;
+			}
+
+			slot.id      = id;
+			slot.request = std::move(request);
+
+			return;
+		}
+	}
+	/**
+	  Removes the request with the id if it is the given request.
+
+	  @param id the request id
+	  @param request the expected request
+	  @returns `true` if the request was removed
+	 */
+	bool erase(double_type id, const request* request) noexcept
+	{
+		auto i = _index(id);
+
+		for (;; i = _next(i)) {
+			auto& slot = _slots[i];
+
+			if (!slot.request) {
+				return false;
+			} else if (slot.id == id) {
+				if (slot.request.get() != request) {
+					return false;
+				}
+
+				break;
+			}
+		}
+
+		// shift the following entries back instead of leaving a tombstone
+		for (auto j = _next(i);; j = _next(j)) {
+			auto& slot = _slots[j];
+
+			if (!slot.request) {
+				break;
+			}
+
+			auto home = _index(slot.id);
+
+			// the entry may only move if its home is not between the hole and itself
+			if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+				_slots[i] = std::move(slot);
+				i         = j;
+			}
+		}
+
+		_slots[i].request.reset();
+		--_size;
+
+		return true;
+	}
+	/**
+	  Calls the function with every request.
+
+	  @param function the function taking the request
+	 */
+	template<typename Function>
+	void for_each(Function function) const
+	{
+		for (auto& slot : _slots) {
+			if (slot.request) {
+				function(slot.request);
+			}
+		}
+	}
+	std::size_t size() const noexcept
+	{
+		return _size;
+	}
+	bool empty() const noexcept
+	{
+		return _size == 0;
+	}
+
+private:
+	struct slot
+	{
+		double_type id;
+		value_type request;
+	};
+
+	std::vector<slot> _slots;
+	std::size_t _size;
+
+	std::size_t _index(double_type id) const noexcept
+	{
+		// spread consecutive ids
+		return (static_cast<std::size_t>(id) * 40503u) & (_slots.size() - 1);
+	}
+	std::size_t _next(std::size_t index) const noexcept
+	{
+		return (index + 1) & (_slots.size() - 1);
+	}
+	void _grow()
+	{
+		std::vector<slot> slots(_slots.size() * 2);
+
+		slots.swap(_slots);
+
+		_size = 0;
+
+		for (auto& slot : slots) {
+			if (slot.request) {
+				insert(slot.id, std::move(slot.request));
+			}
+		}
+	}
+};
+
+} // namespace detail
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define FAST_CGI_HPP_
 
 #include "manipulator/manipulators.hpp"
+#include "multipart.hpp"
 #include "service.hpp"
+#include "urlencoded.hpp"
 
 #endif
\ No newline at end of file
@@ -5,10 +5,13 @@
 
 #include <cstddef>
 #include <functional>
+#include <initializer_list>
 #include <istream>
 #include <memory>
 #include <ostream>
 #include <streambuf>
+#include <string>
+#include <utility>
 
 namespace fast_cgi {
 namespace io {
@@ -18,10 +21,23 @@ typedef char byte_type;
 typedef std::ostream byte_ostream;
 typedef std::istream byte_istream;
 
+struct const_buffer
+{
+	const void* data;
+	std::size_t size;
+};
+
 class input_streambuf : public std::basic_streambuf<byte_type>
 {
 public:
 	input_streambuf(std::shared_ptr<memory::buffer> buffer);
+	/**
+	  Consumes the unread part of the current page without copying it. If everything was read, this waits for the next
+	  page. The chunk stays valid until the stream is read again.
+
+	  @returns the chunk; the size is `0` if the stream ended
+	 */
+	std::pair<const byte_type*, std::size_t> read_chunk();
 
 protected:
 	virtual int_type underflow() override;
@@ -30,12 +46,99 @@ private:
 	std::shared_ptr<memory::buffer> _buffer;
 };
 
+/**
+  Collects the output in pages and hands every full page to the writer. Synchronizing the stream, for example with
+  `std::endl`, does not hand out the current page unless `set_flush_on_sync()` was enabled, so small writes are sent
+  in as few records as possible.
+ */
 class output_streambuf : public std::basic_streambuf<byte_type>
 {
 public:
 	typedef std::function<std::pair<void*, std::size_t>(void*, std::size_t)> writer_type;
+	typedef std::function<void()> flusher_type;
+	typedef std::function<void(const void*, std::size_t, std::shared_ptr<const void>)> adopter_type;
+
+	/**
+	  Creates a new stream buffer.
+
+	  @param writer receives a filled page and returns the next page; the first call receives `nullptr` and the call
+	  of `finish()` may receive an empty page
+	  @param flusher is called after `flush()` handed out the current page; may be empty
+	 */
+	output_streambuf(writer_type writer, flusher_type flusher = nullptr);
+	/**
+	  Hands the current page to the writer even if it is not full.
+	 */
+	void flush();
+	/**
+	  Ends the stream by handing the current page to the writer, even if it is empty. The writer releases the page and
+	  returns no next page; writing afterwards starts with a new page.
+	 */
+	void finish();
+	/**
+	  Sets whether synchronizing the stream flushes it. Disabled by default.
+
+	  @param enable whether to flush on every sync
+	 */
+	void set_flush_on_sync(bool enable) noexcept;
+	/**
+	  Reserves a contiguous region in the current page. If the page has too little space left, it is handed to the
+	  writer, even if it is empty, as long as the writer returns larger pages. The contents are only written after they
+	  were committed. Every other write invalidates the region.
+
+	  @param size the size of the region
+	  @returns the region or `nullptr` if the size exceeds the largest page
+	 */
+	byte_type* reserve(std::size_t size);
+	/**
+	  Commits the first *size* bytes of the last reserved region.
 
-	output_streambuf(writer_type writer);
+	  @param size the written size; must not exceed the reserved size
+	 */
+	void commit(std::size_t size) noexcept;
+	/**
+	  Writes all buffers in order.
+
+	  @param buffers the buffers
+	  @param count the amount of buffers
+	  @returns the total amount of written bytes
+	 */
+	std::size_t write(const const_buffer* buffers, std::size_t count);
+	std::size_t write(std::initializer_list<const_buffer> buffers);
+	/**
+	  Sets the receiver of adopted buffers. Without it, adopted buffers are copied into the pages.
+
+	  @param adopter receives the content and its owner after the current page was handed out; may be empty
+	 */
+	void set_adopter(adopter_type adopter);
+	/**
+	  Sends a buffer without copying it. The current page is handed out first, so the order of the output is kept.
+
+	  @param data the content
+	  @param size the size of the content
+	  @param owner keeps the content alive until it was written; a custom deleter can be passed as
+	  `std::shared_ptr<const void>(data, deleter)`
+	 */
+	void adopt(const void* data, std::size_t size, std::shared_ptr<const void> owner);
+	/**
+	  Takes ownership of the string and sends it without copying it.
+
+	  @param content the content
+	 */
+	void adopt(std::string&& content);
+	/**
+	  Sends the content of a shared container like `std::string` or `std::vector<char>` without copying it.
+
+	  @param content the container; must not be modified until it was released
+	 */
+	template<typename Container>
+	void adopt(std::shared_ptr<Container> content)
+	{
+		auto data = content->data();
+		auto size = content->size() * sizeof(*data);
+
+		adopt(data, size, std::move(content));
+	}
 
 protected:
 	virtual std::streamsize xsputn(const char_type* s, std::streamsize count) override;
@@ -44,6 +147,14 @@ protected:
 
 private:
 	writer_type _writer;
+	flusher_type _flusher;
+	adopter_type _adopter;
+	bool _flush_on_sync;
+
+	/**
+	  Hands the current page to the writer and continues with the next page.
+	 */
+	void _next_page();
 };
 
 } // namespace io
@@ -0,0 +1,102 @@
+#ifndef FAST_CGI_IO_COMPRESSOR_HPP_
+#define FAST_CGI_IO_COMPRESSOR_HPP_
+
+#include "../memory/buffer_manager.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace fast_cgi {
+namespace io {
+
+/**
+  Compresses the body of a CGI response. The header block is passed through unchanged except for additional
+  `Content-Encoding` and `Vary` headers and a removed `Content-Length`. If the role already set a `Content-Encoding`,
+  answered with status 204 or 304 or wrote no body at all, the whole response is passed through.
+  Compressed data is collected in pages of the buffer manager which are handed to the sink when they are full. The
+  pages grow with every page up to the largest size class.
+ */
+class compressor
+{
+public:
+	enum class encoding
+	{
+		identity,
+		gzip,
+		deflate
+	};
+
+	typedef std::function<void(void*, std::size_t)> sink_type;
+
+	/**
+	  Selects the preferred encoding from the value of an `Accept-Encoding` header.
+
+	  @param accept_encoding the header value
+	  @returns the preferred encoding or `encoding::identity` if nothing is supported or the library was built without
+	           zlib
+	 */
+	static encoding negotiate(const std::string& accept_encoding);
+	/**
+	  Creates a new compressor.
+
+	  @param content_encoding the content encoding; must not be `encoding::identity`
+	  @param level the zlib compression level
+	  @param buffer_manager the manager providing the output pages
+	  @param sink receives every filled page; the sink takes ownership of the page
+	  @throws exception::io_error if the stream cannot be initialized or the library was built without zlib
+	 */
+	compressor(encoding content_encoding, int level, memory::buffer_manager& buffer_manager, sink_type sink);
+	compressor(const compressor& copy) = delete;
+	~compressor();
+	void write(const void* data, std::size_t size);
+	/**
+	  Hands everything written so far to the sink. The compressed stream is flushed to a byte boundary, which slightly
+	  reduces the compression ratio. Nothing is handed out before the first byte of the body.
+	 */
+	void flush();
+	/**
+	  Finishes the compressed stream and hands the last page to the sink. Calling this function more than once has no
+	  effect.
+	 */
+	void finish();
+
+private:
+	enum class STATE
+	{
+		header,
+		/** the header block is complete but no body was written yet */
+		pending,
+		body,
+		passthrough,
+		finished
+	};
+
+	struct stream;
+
+	STATE _state;
+	encoding _encoding;
+	std::unique_ptr<stream> _stream;
+	memory::buffer_manager& _buffer_manager;
+	sink_type _sink;
+	std::string _header;
+	void* _page;
+	std::size_t _page_used;
+	/** the usable size of the current page */
+	std::size_t _page_capacity;
+
+	void _write_header(const void* data, std::size_t size);
+	/**
+	  Writes the rewritten header block and starts the compressed body.
+	 */
+	void _begin_body();
+	void _write_raw(const void* data, std::size_t size);
+	void _deflate(const void* data, std::size_t size, int flush);
+	void _next_page();
+};
+
+} // namespace io
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef FAST_CGI_IO_FORMAT_HPP_
+#define FAST_CGI_IO_FORMAT_HPP_
+
+#include "../exception/format_error.hpp"
+#include "../string_view.hpp"
+#include "byte_stream.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace fast_cgi {
+namespace io {
+
+/**
+  A type erased format argument. Numbers are printed like `operator<<` of a default stream without consulting the
+  locale.
+ */
+struct format_argument
+{
+	enum class TYPE
+	{
+		none,
+		signed_integer,
+		unsigned_integer,
+		floating,
+		character,
+		string
+	};
+
+	TYPE type;
+	union
+	{
+		long long signed_integer;
+		unsigned long long unsigned_integer;
+		double floating;
+		char character;
+		const_buffer string;
+	};
+
+	format_argument() noexcept : type(TYPE::none), unsigned_integer(0)
+	{}
+	template<typename T>
+	format_argument(T value, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value &&
+	                                                 (sizeof(T) > 1)>::type* = nullptr) noexcept
+	    : type(TYPE::signed_integer), signed_integer(value)
+	{}
+	template<typename T>
+	format_argument(T value, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value &&
+	                                                 (sizeof(T) > 1 || std::is_same<T, bool>::value)>::type* =
+	                             nullptr) noexcept
+	    : type(TYPE::unsigned_integer), unsigned_integer(value)
+	{}
+	template<typename T>
+	format_argument(T value, typename std::enable_if<std::is_floating_point<T>::value>::type* = nullptr) noexcept
+	    : type(TYPE::floating), floating(static_cast<double>(value))
+	{}
+	format_argument(char value) noexcept : type(TYPE::character), character(value)
+	{}
+	format_argument(signed char value) noexcept : type(TYPE::character), character(static_cast<char>(value))
+	{}
+	format_argument(unsigned char value) noexcept : type(TYPE::character), character(static_cast<char>(value))
+	{}
+	format_argument(const char* value) noexcept : type(TYPE::string), string{ value, std::strlen(value) }
+	{}
+	format_argument(const std::string& value) noexcept : type(TYPE::string), string{ value.data(), value.size() }
+	{}
+	format_argument(string_view value) noexcept : type(TYPE::string), string{ value.data(), value.size() }
+	{}
+};
+
+/** the maximum size of a formatted number */
+constexpr std::size_t max_number_size = 32;
+
+std::size_t format_number(char* output, long long value) noexcept;
+std::size_t format_number(char* output, unsigned long long value) noexcept;
+std::size_t format_number(char* output, double value) noexcept;
+/**
+  Writes the format string to the buffer and replaces every `{}` with the next argument. `{{` and `}}` are written as
+  `{` and `}`.
+
+  @param buffer the output buffer
+  @param format the format string
+  @param arguments the arguments
+  @param count the amount of arguments
+  @throws exception::format_error if there are more placeholders than arguments
+ */
+void vformat(output_streambuf& buffer, const char* format, const format_argument* arguments, std::size_t count);
+/**
+  Formats the arguments directly into the output buffer. See `vformat()`.
+ */
+template<typename... Args>
+inline void format(output_streambuf& buffer, const char* format, const Args&... args)
+{
+	// the last element allows empty argument lists
+	const format_argument arguments[] = { format_argument(args)..., format_argument() };
+
+	vformat(buffer, format, arguments, sizeof...(Args));
+}
+
+} // namespace io
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -4,8 +4,10 @@
 #include "../connection.hpp"
 #include "../memory/allocator.hpp"
 #include "../memory/buffer.hpp"
+#include "../memory/governor.hpp"
 #include "reader.hpp"
 
+#include <cstddef>
 #include <memory>
 
 namespace fast_cgi {
@@ -14,14 +16,31 @@ namespace io {
 class input_manager
 {
 public:
+	/** the default maximum amount of unread input of a connection */
+	constexpr static std::size_t default_capacity = 1048576;
+
+	/**
+	  Launches a thread reading from the connection. The thread stops reading while the unread input exceeds the
+	  capacity.
+
+	  @param connection the connection
+	  @param allocator the allocator of the input buffer
+	  @param governor throttles reading while the memory limit is exceeded; may be `nullptr`
+	  @param capacity the maximum amount of unread input
+	  @returns the reader of the input
+	 */
 	static std::shared_ptr<reader> launch_input_manager(std::shared_ptr<connection> connection,
-	                                                    std::shared_ptr<memory::allocator> allocator);
+	                                                    std::shared_ptr<memory::allocator> allocator,
+	                                                    std::shared_ptr<memory::governor> governor = nullptr,
+	                                                    std::size_t capacity = default_capacity);
 
 private:
 	std::shared_ptr<memory::buffer> _buffer;
 	std::shared_ptr<connection> _connection;
+	std::shared_ptr<memory::governor> _governor;
 
-	input_manager(std::shared_ptr<connection> connection, std::shared_ptr<memory::allocator> allocator);
+	input_manager(std::shared_ptr<connection> connection, std::shared_ptr<memory::allocator> allocator,
+	              std::shared_ptr<memory::governor> governor, std::size_t capacity);
 	static void _run(std::shared_ptr<input_manager> self);
 };
 
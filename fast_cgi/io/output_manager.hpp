@@ -2,6 +2,7 @@
 #define FAST_CGI_IO_OUTPUT_MANAGER_HPP_
 
 #include "../connection.hpp"
+#include "../detail/config.hpp"
 #include "../memory/allocator.hpp"
 #include "../memory/buffer_manager.hpp"
 #include "writer.hpp"
@@ -27,17 +28,35 @@ public:
 	~output_manager();
 	memory::buffer_manager& buffer_manager() noexcept;
 	/**
-	  Adds a writing task to the queue. The task are executed on a different thread at an unspecified time.
+	  Adds a writing task to the queue. The task are executed on a different thread at an unspecified time. The task is
+	  destroyed right after it was executed. If the connection failed, the task is destroyed immediately.
 
 	  @param task is the writing task
-	  @returns a future that will be completed when the writing task finished
+	  @param request_id the request whose abort discards the task; `0` if the task must be written
 	 */
-	std::shared_ptr<std::atomic_bool> add(task_type task);
+	void add(task_type task, detail::double_type request_id = 0);
+	/**
+	  Removes all queued tasks of the request that were added with its id. The tasks are destroyed, which returns
+	  their pages.
+
+	  @param request_id the request id
+	  @returns the amount of removed tasks
+	 */
+	std::size_t discard(detail::double_type request_id);
+	/**
+	  Returns the amount of queued tasks.
+	 */
+	std::size_t pending();
+	/**
+	  Returns whether writing to the connection failed. All further tasks are dropped.
+	 */
+	bool failed() const noexcept;
 
 private:
-	typedef std::pair<task_type, std::shared_ptr<std::atomic_bool>> queue_type;
+	typedef std::pair<detail::double_type, task_type> queue_type;
 
 	bool _alive;
+	std::atomic_bool _failed;
 	std::deque<queue_type> _queue;
 	std::mutex _mutex;
 	std::condition_variable _cv;
@@ -46,6 +65,10 @@ private:
 	memory::buffer_manager _buffer_manager;
 
 	void _run();
+	/**
+	  Marks the connection as failed and drops all queued tasks.
+	 */
+	void _fail();
 };
 
 } // namespace io
@@ -0,0 +1,128 @@
+#ifndef FAST_CGI_MEMORY_ARENA_HPP_
+#define FAST_CGI_MEMORY_ARENA_HPP_
+
+#include "allocator.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace fast_cgi {
+namespace memory {
+
+/**
+  A monotonic allocator. Deallocation has no effect; all memory is freed at once by `reset()` or `release()`. An arena
+  must not be shared between threads.
+ */
+class arena : public allocator
+{
+public:
+	constexpr static std::size_t default_chunk_size        = 4096;
+	constexpr static std::size_t default_max_retained_size = 65536;
+
+	/**
+	  Creates a new arena.
+
+	  @param allocator the allocator providing the chunks
+	  @param chunk_size the minimum size of a chunk
+	  @param max_retained_size the maximum size of the chunk kept by `reset()`
+	 */
+	arena(std::shared_ptr<allocator> allocator, std::size_t chunk_size = default_chunk_size,
+	      std::size_t max_retained_size = default_max_retained_size);
+	arena(const arena& copy) = delete;
+	~arena();
+	using allocator::allocate;
+	virtual void* allocate(std::size_t size, std::size_t align) override;
+	virtual void deallocate(void* ptr, std::size_t size) override;
+	/**
+	  Frees all allocations. The largest chunk not exceeding the maximum retained size is kept for reuse, so that a
+	  single large request does not pin its memory.
+	 */
+	void reset() noexcept;
+	/**
+	  Frees all allocations and chunks.
+	 */
+	void release() noexcept;
+	/**
+	  Returns the total size of all chunks.
+	 */
+	std::size_t capacity() const noexcept;
+
+private:
+	struct chunk
+	{
+		chunk* next;
+		std::size_t size;
+	};
+
+	std::shared_ptr<allocator> _allocator;
+	std::size_t _chunk_size;
+	std::size_t _max_retained_size;
+	chunk* _chunks;
+	std::size_t _capacity;
+	std::uint8_t* _begin;
+	std::uint8_t* _end;
+};
+
+/**
+  A standard allocator backed by an arena. Without an arena the global `operator new` is used. Copies of containers
+  do not inherit the arena because they may outlive it.
+ */
+template<typename T>
+class arena_allocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	arena_allocator(class arena* arena = nullptr) noexcept : _arena(arena)
+	{}
+	template<typename U>
+	arena_allocator(const arena_allocator<U>& other) noexcept : _arena(other.arena())
+	{}
+	T* allocate(std::size_t count)
+	{
+		if (_arena) {
+			return static_cast<T*>(_arena->allocate(count * sizeof(T), alignof(T)));
+		}
+
+		return static_cast<T*>(::operator new(count * sizeof(T)));
+	}
+	void deallocate(T* ptr, std::size_t /* count */) noexcept
+	{
+		if (!_arena) {
+			::operator delete(ptr);
+		}
+	}
+	arena_allocator select_on_container_copy_construction() const noexcept
+	{
+		return {};
+	}
+	class arena* arena() const noexcept
+	{
+		return _arena;
+	}
+
+private:
+	class arena* _arena;
+};
+
+template<typename T, typename U>
+inline bool operator==(const arena_allocator<T>& left, const arena_allocator<U>& right) noexcept
+{
+	return left.arena() == right.arena();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const arena_allocator<T>& left, const arena_allocator<U>& right) noexcept
+{
+	return left.arena() != right.arena();
+}
+
+} // namespace memory
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -3,16 +3,22 @@
 
 #include "allocator.hpp"
 
+#include <atomic>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
-#include <deque>
+#include <memory>
 #include <mutex>
 #include <utility>
 
 namespace fast_cgi {
 namespace memory {
 
+/**
+  A single-producer/single-consumer byte stream made of pages. The producer and the consumer do not share a lock; the
+  consumer only locks when it has to block for new input and the producer only notifies when a consumer is blocked.
+  If a capacity is set, the producer can wait until the consumer has read enough.
+ */
 class buffer
 {
 public:
@@ -24,7 +30,8 @@ public:
 		~writer();
 		/**
 		  Returns a buffer where the user can write his contents. The returned buffer size may be smaller than the
-		  desired size.
+		  desired size. The contents are published to the consumer with the next call of this function or when the
+		  token is closed.
 
 		  @param desired the desired size of the buffer
 		  @returns the buffer pointer and its size; if `size==0` the buffer is full or the token has been closed
@@ -43,24 +50,65 @@ public:
 		friend buffer;
 
 		buffer* _buffer;
-		std::unique_lock<std::mutex> _lock;
+		/** the size of the last requested buffer which was not published yet */
+		std::size_t _pending;
 
 		writer(buffer* buffer);
+		void _publish() noexcept;
 	};
 
+	constexpr static std::size_t default_min_page_size = 1024;
+	constexpr static std::size_t default_max_page_size = 65536;
+
 	/**
-	  Creates a new buffer with the given max size.
+	  Creates a new buffer with the given max size. The size of the pages doubles with every page from *min_page_size*
+	  up to *max_page_size*.
 
 	  @param allocator the memory allocator
 	  @param max_size the maximum allowed buffer size
+	  @param min_page_size the size of the first page
+	  @param max_page_size the maximum page size
 	 */
-	buffer(std::shared_ptr<allocator> allocator, std::size_t max_size);
+	buffer(std::shared_ptr<allocator> allocator, std::size_t max_size,
+	       std::size_t min_page_size = default_min_page_size, std::size_t max_page_size = default_max_page_size);
 	buffer(const buffer& copy) = delete;
 	buffer(buffer&& move)      = delete;
 	~buffer();
 	void interrupt_all_waiting();
-	bool interrupted();
+	bool interrupted() noexcept;
 	void set_max(std::size_t max);
+	/**
+	  Sets the maximum amount of unread bytes the producer waits for with `wait_for_space()`. The buffer is unbounded by
+	  default.
+
+	  @param capacity the capacity
+	 */
+	void set_capacity(std::size_t capacity) noexcept;
+	/**
+	  Blocks the producer until the unread content is smaller than the capacity, the consumer abandoned the buffer or
+	  the buffer was interrupted. Must only be called by the producer.
+
+	  @param other another buffer of the same producer; if its consumer waits for input, the producer stops waiting and
+	  exceeds the capacity. The consumer wakes the producer when it starts waiting. May be `nullptr`
+	  @returns `false` if the content should be discarded instead of written
+	 */
+	bool wait_for_space(buffer* other = nullptr);
+	/**
+	  Tells the producer that nothing will be read anymore. Waiting producers are woken up.
+	 */
+	void abandon();
+	bool abandoned() noexcept;
+	/**
+	  Returns whether the consumer is blocked waiting for input.
+	 */
+	bool consumer_waiting() noexcept;
+	/**
+	  Discards all contents and prepares the buffer for a new stream. Some pages are kept for reuse and the capacity
+	  stays unchanged. Must not be called while a writer token exists or a thread consumes the buffer.
+
+	  @param max_size the maximum allowed buffer size
+	 */
+	void reset(std::size_t max_size) noexcept;
 	/**
 	  Blocks until the buffer has reached max size.
 
@@ -68,7 +116,8 @@ public:
 	 */
 	void wait_for_all_input();
 	/**
-	  Waits until new input is available. Every input returned by previous calls to this function are invalidated.
+	  Waits until new input is available. Every input returned by previous calls to this function are invalidated. Only
+	  one thread may consume the buffer.
 
 	  @returns the new input or `{nullptr, 0}` if no more input is available
 	  @throws exception::interrupted_exception if reading was interrupted
@@ -81,8 +130,12 @@ public:
 	bool output_closed() noexcept;
 	bool input_closed() noexcept;
 	/**
-	  Locks the buffer and starts writing. The lock is released when the returned token is destroyed or closed. Sharing
-	  a token between threads results in undefined behavior. This token may **not** exist longer than this instance.
+	  Returns the amount of published bytes that were not consumed yet.
+	 */
+	std::size_t size() noexcept;
+	/**
+	  Starts writing. Only one token may exist at a time and sharing a token between threads results in undefined
+	  behavior. This token may **not** exist longer than this instance.
 
 	  @returns the writer token
 	 */
@@ -91,26 +144,72 @@ public:
 private:
 	struct page
 	{
-		constexpr static auto max_size = 4096;
-		void* begin;
-		std::size_t size;
+		/** the maximum amount of consumed pages kept for reuse */
+		constexpr static auto max_free = 4;
+		void* const begin;
+		const std::size_t size;
+		/** how much the producer has published */
+		std::atomic<std::size_t> written;
+		/** how much the consumer has read; only accessed by the consumer */
 		std::size_t consumed;
-		std::size_t written;
+		std::atomic<page*> next;
+
+		page(void* begin, std::size_t size) noexcept;
 	};
 
-	bool _interrupted;
+	std::atomic_bool _interrupted;
+	std::atomic_bool _abandoned;
 	std::shared_ptr<allocator> _allocator;
-	std::mutex _mutex;
-	std::condition_variable _waiter;
-	std::deque<page> _pages;
+	/** the first page ever written */
+	std::atomic<page*> _first;
+	/** the page the consumer is reading from; only accessed by the consumer */
+	page* _head;
+	/** the page the producer is writing to; only accessed by the producer */
+	page* _tail;
+	/** consumed pages returned by the consumer */
+	std::atomic<page*> _free;
+	std::atomic<int> _free_count;
+	/** consumed pages taken over by the producer; only accessed by the producer */
+	page* _spare;
+	std::size_t _min_page_size;
+	std::size_t _max_page_size;
+	/** the size of the next allocated page; only accessed by the producer */
+	std::size_t _next_page_size;
 	/** how much has already been written */
-	std::size_t _write_total;
+	std::atomic<std::size_t> _write_total;
 	/** how much has already been consumed */
-	std::size_t _consume_total;
+	std::atomic<std::size_t> _consume_total;
 	/** the maximum allowed size */
-	std::size_t _max_size;
+	std::atomic<std::size_t> _max_size;
+	/** the maximum amount of unread bytes */
+	std::atomic<std::size_t> _capacity;
+	/** the amount of threads blocking in `_wait()` */
+	std::atomic<int> _waiting;
+	/** whether the producer blocks in `wait_for_space()` */
+	std::atomic_bool _producer_waiting;
+	/** the buffer whose producer waits in `wait_for_space()` until the consumer of this buffer waits */
+	std::atomic<buffer*> _watcher;
+	std::mutex _mutex;
+	std::condition_variable _waiter;
 
 	page& append_new_page();
+	/**
+	  Returns a consumed page for reuse by the producer. Must only be called by the consumer.
+	 */
+	void _recycle(page* page) noexcept;
+	/**
+	  Finds the next page with unread contents. Must only be called by the consumer.
+	 */
+	page* _readable_page() noexcept;
+	/**
+	  Blocks until the predicate is satisfied.
+	 */
+	template<typename Predicate>
+	void _wait(Predicate predicate);
+	/**
+	  Wakes up all blocking threads.
+	 */
+	void _notify();
 };
 
 } // namespace memory
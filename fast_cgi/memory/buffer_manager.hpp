@@ -6,28 +6,121 @@
 #include <atomic>
 #include <cstddef>
 #include <memory>
-#include <set>
-#include <vector>
+#include <mutex>
 
 namespace fast_cgi {
 namespace memory {
 
+class buffer_manager;
+
+/**
+  A reference to a page of a buffer manager. The page returns to the free list of its manager when the last reference
+  is dropped.
+ */
+class page_handle
+{
+public:
+	page_handle() noexcept;
+	page_handle(const page_handle& copy) noexcept;
+	page_handle(page_handle&& move) noexcept;
+	~page_handle();
+	page_handle& operator=(page_handle other) noexcept;
+	void* get() const noexcept;
+	explicit operator bool() const noexcept;
+
+private:
+	friend buffer_manager;
+
+	void* _page;
+
+	explicit page_handle(void* page) noexcept;
+};
+
+/**
+  Hands out pages in size classes, which are powers of two from the default page size up to `max_page_size`. Every
+  page carries an intrusive reference count and free pages are kept in lock-free lists per size class; the smallest
+  class keeps up to `max_free` pages and every larger class half as many as the one before. All pages are released
+  when the manager is destroyed.
+ */
 class buffer_manager
 {
 public:
+	/** the maximum amount of free pages of the smallest class kept for reuse */
+	constexpr static std::size_t max_free = 16;
+	/** the allocation size of the largest class; its usable size still fits into a single record */
+	constexpr static std::size_t max_page_size = 65536;
+
+	/**
+	  Creates a new manager.
+
+	  @param page_size the allocation size of the smallest class including the page header; a power of two
+	  @param allocator the allocator of the pages
+	 */
 	buffer_manager(std::size_t page_size, std::shared_ptr<allocator> allocator);
 	buffer_manager(const buffer_manager& copy) = delete;
 	buffer_manager(buffer_manager&& copy)      = delete;
 	~buffer_manager();
-	void free_page(void* page, std::shared_ptr<std::atomic_bool> tracker = nullptr);
+	/**
+	  Drops the reference of the caller to the page.
+
+	  @param page the page returned by `new_page()`
+	 */
+	void free_page(void* page) noexcept;
+	/**
+	  Returns a page of the smallest class with a single reference owned by the caller.
+	 */
 	void* new_page();
+	/**
+	  Returns a page with a single reference owned by the caller.
+
+	  @param size the desired usable size; larger sizes than the largest class are capped
+	  @returns a page of the smallest class that can hold *size* bytes
+	 */
+	void* new_page(std::size_t size);
+	/**
+	  Transfers the reference of the caller to a handle.
+
+	  @param page the page returned by `new_page()`
+	  @returns the handle
+	 */
+	static page_handle adopt(void* page) noexcept;
+	/**
+	  Returns the usable size of a page of the smallest class.
+	 */
 	std::size_t page_size() const noexcept;
+	/**
+	  Returns the usable size of the page.
+
+	  @param page the page returned by `new_page()`
+	 */
+	static std::size_t page_size(void* page) noexcept;
+	/**
+	  Returns the usable size of a page of the largest class.
+	 */
+	std::size_t max_size() const noexcept;
 
 private:
+	friend page_handle;
+
+	struct header;
+	struct free_list;
+
+	/** the size of the header in front of every page */
+	static const std::size_t _header_size;
 	std::shared_ptr<allocator> _allocator;
 	std::size_t _page_size;
-	std::set<void*> _pages;
-	std::vector<std::pair<void*, std::shared_ptr<std::atomic_bool>>> _free_pages;
+	std::size_t _class_count;
+	/** every allocated page */
+	header* _pages;
+	std::mutex _pages_mutex;
+	std::unique_ptr<free_list[]> _free_pages;
+	/** only one thread may pop at a time which prevents the ABA problem */
+	std::mutex _pop_mutex;
+
+	static header* _header(void* page) noexcept;
+	static void _release(header* header) noexcept;
+	void _push(header* header) noexcept;
+	void _deallocate(header* header) noexcept;
 };
 
 } // namespace memory
@@ -0,0 +1,68 @@
+#ifndef FAST_CGI_MEMORY_CACHING_ALLOCATOR_HPP_
+#define FAST_CGI_MEMORY_CACHING_ALLOCATOR_HPP_
+
+#include "allocator.hpp"
+
+#include <cstddef>
+#include <memory>
+
+namespace fast_cgi {
+namespace memory {
+
+/**
+  An allocator for the page sized blocks used by the buffers. Sizes up to `max_class_size` are rounded up to the next
+  power of two and served from per-thread caches. Blocks freed on another thread than they were allocated on are
+  exchanged in batches through a central depot. Larger sizes are forwarded to `std::malloc()`.
+
+  Cached blocks are only returned to the system when the allocator and all thread caches that used it are destroyed.
+ */
+class caching_allocator : public allocator
+{
+public:
+	struct statistics
+	{
+		/** the size of all slabs in bytes */
+		std::size_t reserved;
+		/** the amount of allocations larger than `max_class_size` */
+		std::size_t large_allocations;
+		/** the amount of batches moved between the thread caches and the depot */
+		std::size_t depot_transfers;
+		/** the amount of blocks currently cached in the depot */
+		std::size_t depot_blocks;
+	};
+
+	constexpr static std::size_t min_class_size = 64;
+	constexpr static std::size_t max_class_size = 65536;
+	/** the minimum alignment of all blocks; a block of a size class is also aligned to its size */
+	constexpr static std::size_t alignment = 64;
+	/** the amount of blocks moved between a thread cache and the depot at once */
+	constexpr static std::size_t batch_size = 16;
+
+	caching_allocator();
+	/**
+	  Allocates a block.
+
+	  @param size the size of the block
+	  @param align the alignment; a power of two that does not exceed the size class for sizes up to
+	               `max_class_size`
+	  @returns the block
+	  @throws std::invalid_argument if the alignment is not supported
+	  @throws std::bad_alloc if the memory is exhausted
+	 */
+	virtual void* allocate(std::size_t size, std::size_t align) override;
+	virtual void deallocate(void* ptr, std::size_t size) override;
+	statistics stats() const;
+
+private:
+	struct depot;
+	struct thread_cache;
+
+	std::shared_ptr<depot> _depot;
+
+	thread_cache& _thread_cache();
+};
+
+} // namespace memory
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -0,0 +1,107 @@
+#ifndef FAST_CGI_MEMORY_GOVERNOR_HPP_
+#define FAST_CGI_MEMORY_GOVERNOR_HPP_
+
+#include "allocator.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace fast_cgi {
+namespace memory {
+
+/**
+  Tracks the memory of all connections of a service. Allocations are never refused; instead new requests are rejected
+  with `FCGI_OVERLOADED` and reading from the connections and writing the output is throttled while the limit is
+  exceeded.
+ */
+class governor : public std::enable_shared_from_this<governor>
+{
+public:
+	enum class CATEGORY
+	{
+		/** the raw input of the connections */
+		connection_input,
+		/** the parameter streams and the arenas of the requests */
+		params,
+		/** the stdin and data streams */
+		input,
+		/** the output pages */
+		output
+	};
+
+	constexpr static std::size_t category_count = 4;
+	/** how often a throttled caller checks whether it has drained */
+	constexpr static std::chrono::milliseconds drain_interval{ 10 };
+
+	struct statistics
+	{
+		/** the amount of bytes currently allocated */
+		std::size_t used;
+		std::size_t peak;
+		/** the amount of bytes per category */
+		std::size_t categories[category_count];
+		/** the amount of rejected requests */
+		std::size_t refused;
+		/** how often a reader or writer was throttled */
+		std::size_t throttled;
+	};
+
+	/**
+	  Creates a new governor.
+
+	  @param limit the amount of bytes above which the service is under pressure
+	 */
+	governor(std::size_t limit);
+	governor(const governor& copy) = delete;
+	/**
+	  Creates an allocator that accounts all allocations to the category.
+
+	  @param allocator the actual allocator
+	  @param category the category
+	  @returns the accounting allocator
+	 */
+	std::shared_ptr<allocator> track(std::shared_ptr<allocator> allocator, CATEGORY category);
+	bool under_pressure() const noexcept;
+	/**
+	  Blocks while the service is under pressure. The caller is woken up as soon as the usage drops below the limit. To
+	  guarantee progress the caller is not blocked once it has nothing pending, which is checked every
+	  `drain_interval`.
+
+	  @param drained whether the caller has nothing pending
+	 */
+	void throttle(const std::function<bool()>& drained);
+	/**
+	  Counts a rejected request.
+	 */
+	void refuse() noexcept;
+	statistics stats() const noexcept;
+	std::size_t limit() const noexcept;
+
+private:
+	class tracker;
+
+	const std::size_t _limit;
+	std::atomic<std::size_t> _used;
+	std::atomic<std::size_t> _peak;
+	std::atomic<std::size_t> _categories[category_count];
+	std::atomic<std::size_t> _refused;
+	std::atomic<std::size_t> _throttled;
+	/** the amount of throttled callers */
+	std::atomic<std::size_t> _waiting;
+	std::mutex _mutex;
+	/** notified when the usage drops below the limit */
+	std::condition_variable _relief;
+
+	void _add(CATEGORY category, std::size_t size) noexcept;
+	void _remove(CATEGORY category, std::size_t size) noexcept;
+};
+
+} // namespace memory
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+#ifndef FAST_CGI_MEMORY_HUGE_PAGE_ALLOCATOR_HPP_
+#define FAST_CGI_MEMORY_HUGE_PAGE_ALLOCATOR_HPP_
+
+#include "allocator.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace fast_cgi {
+namespace memory {
+
+/**
+  An allocator carving the pages of the buffers out of large regions backed by huge pages. Sizes up to `max_block_size`
+  are rounded up to the next power of two, which covers the largest pages of the buffers, and every block is aligned
+  to its size; larger sizes are forwarded to `posix_memalign()` or `std::malloc()`.
+
+  Regions are mapped with `MAP_HUGETLB` if huge pages are reserved in the system, otherwise transparent huge pages are
+  requested with `madvise()`. If neither is available, the regions are backed by normal pages. Regions are only
+  returned to the system when the allocator is destroyed.
+ */
+class huge_page_allocator : public allocator
+{
+public:
+	struct statistics
+	{
+		/** the size of all regions in bytes */
+		std::size_t reserved;
+		std::size_t regions;
+		/** the amount of regions backed by reserved huge pages */
+		std::size_t hugetlb_regions;
+		/** the amount of regions advised to use transparent huge pages */
+		std::size_t advised_regions;
+	};
+
+	constexpr static std::size_t min_block_size = 1024;
+	constexpr static std::size_t max_block_size = 65536;
+	constexpr static std::size_t default_region_size = 2 * 1024 * 1024;
+
+	/**
+	  Creates a new allocator.
+
+	  @param region_size the size of a region; a multiple of the huge page size
+	  @param prefault the amount of bytes mapped and touched immediately
+	 */
+	huge_page_allocator(std::size_t region_size = default_region_size, std::size_t prefault = 0);
+	huge_page_allocator(const huge_page_allocator& copy) = delete;
+	~huge_page_allocator();
+	/**
+	  Allocates a block.
+
+	  @param size the size of the block
+	  @param align the alignment; a power of two that does not exceed the size class for sizes up to
+	               `max_block_size`
+	  @returns the block
+	  @throws std::invalid_argument if the alignment is not supported
+	  @throws std::bad_alloc if the memory is exhausted
+	 */
+	virtual void* allocate(std::size_t size, std::size_t align) override;
+	virtual void deallocate(void* ptr, std::size_t size) override;
+	statistics stats() const;
+
+private:
+	constexpr static std::size_t class_count = 7;
+
+	struct block
+	{
+		block* next;
+	};
+
+	struct region
+	{
+		void* begin;
+		std::size_t size;
+		bool hugetlb;
+	};
+
+	std::size_t _region_size;
+	mutable std::mutex _mutex;
+	block* _free[class_count];
+	std::vector<region> _regions;
+	/** the unused part of the last region */
+	char* _begin;
+	char* _end;
+	statistics _statistics;
+
+	void _map_region(bool prefault);
+	void _unmap_region(const region& region) noexcept;
+	/**
+	  Splits the range into the largest blocks that are aligned to their size and adds them to the free lists. A rest
+	  smaller than `min_block_size` is lost.
+	 */
+	void _release(char* begin, char* end) noexcept;
+};
+
+} // namespace memory
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -0,0 +1,134 @@
+#ifndef FAST_CGI_MULTIPART_HPP_
+#define FAST_CGI_MULTIPART_HPP_
+
+#include "string_view.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <string>
+
+namespace fast_cgi {
+
+/**
+  A streaming parser for `multipart/form-data` content. The content is fed in chunks, for example the pages of the
+  input of a responder, and the parts are reported to the handlers while they arrive. Body chunks are views into the
+  fed chunks, except for the few bytes around a chunk border that could be the start of a boundary. The headers of a
+  part are collected in an internal buffer.
+
+  Views passed to a handler are only valid during the call.
+ */
+class multipart
+{
+public:
+	/** receives the raw header block of a new part without the terminating empty line */
+	typedef std::function<void(string_view headers)> part_handler_type;
+	/** receives the next chunk of the body of the current part */
+	typedef std::function<void(string_view chunk)> data_handler_type;
+	/** is called after the last chunk of the current part */
+	typedef std::function<void()> end_handler_type;
+
+	constexpr static std::size_t default_max_header_size = 16384;
+
+	/**
+	  Creates a new parser.
+
+	  @param boundary the boundary without the leading `--`
+	  @param part_handler the handler for new parts
+	  @param data_handler the handler for body chunks
+	  @param end_handler the handler for finished parts; may be empty
+	  @param max_header_size the maximum size of the headers of a part
+	 */
+	multipart(string_view boundary, part_handler_type part_handler, data_handler_type data_handler,
+	          end_handler_type end_handler = nullptr, std::size_t max_header_size = default_max_header_size);
+	/**
+	  Parses the next chunk.
+
+	  @param chunk the chunk
+	  @throws exception::parse_error if the headers of a part are too large
+	 */
+	void feed(string_view chunk);
+	/**
+	  Reads the stream until its end and parses the content. If the stream is the input of a role, the pages are
+	  parsed without copying them.
+
+	  @param[in] input the stream
+	  @throws exception::parse_error if the stream ended before the final boundary or the headers are too large
+	 */
+	void parse(std::istream& input);
+	/**
+	  Returns whether the final boundary was found. Everything after it is ignored.
+	 */
+	bool finished() const noexcept;
+	/**
+	  Extracts the boundary parameter of a `Content-Type` value.
+
+	  @param content_type the value, for example `multipart/form-data; boundary=abc`
+	  @returns the boundary or an empty view
+	 */
+	static string_view boundary_of(string_view content_type) noexcept;
+	/**
+	  Finds a header in a header block. The name is compared case-insensitively.
+
+	  @param headers the headers as passed to the part handler
+	  @param name the name of the header
+	  @returns the trimmed value or an empty view
+	 */
+	static string_view header(string_view headers, string_view name) noexcept;
+	/**
+	  Finds a parameter of a header value, like `name` or `filename` of `Content-Disposition`. Quotes are removed.
+
+	  @param value the header value
+	  @param name the name of the parameter
+	  @returns the parameter value or an empty view
+	 */
+	static string_view parameter(string_view value, string_view name) noexcept;
+
+private:
+	enum class STATE
+	{
+		/** skipping everything before the first boundary */
+		preamble,
+		/** skipping the rest of the boundary line */
+		boundary_line,
+		/** found `-` after the boundary */
+		boundary_dash,
+		/** found `\r` after the boundary */
+		boundary_end,
+		headers,
+		body,
+		finished
+	};
+
+	/** `\r\n--` followed by the boundary */
+	std::string _delimiter;
+	part_handler_type _part_handler;
+	data_handler_type _data_handler;
+	end_handler_type _end_handler;
+	std::size_t _max_header_size;
+	STATE _state;
+	/** the end of the last chunk if it could be the start of the delimiter */
+	std::string _carry;
+	std::string _headers;
+
+	/**
+	  Searches the delimiter in the body or preamble and passes the content to the data handler.
+
+	  @returns the amount of consumed bytes
+	 */
+	std::size_t _consume_body(const char* data, std::size_t size);
+	/**
+	  Consumes the carry if the chunk proves that it is not the start of the delimiter.
+
+	  @returns the amount of consumed bytes of the chunk
+	 */
+	std::size_t _consume_carry(const char* data, std::size_t size);
+	std::size_t _consume_boundary_line(const char* data, std::size_t size) noexcept;
+	std::size_t _consume_headers(const char* data, std::size_t size);
+	void _emit(const char* data, std::size_t size);
+	void _delimiter_found();
+};
+
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -0,0 +1,143 @@
+#ifndef FAST_CGI_RESPONSE_CACHE_HPP_
+#define FAST_CGI_RESPONSE_CACHE_HPP_
+
+#include "detail/config.hpp"
+#include "detail/params.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fast_cgi {
+
+/**
+  Caches complete responder outputs keyed on selected request parameters. Only `GET` and `HEAD` requests are cached
+  and a response is not stored if it sets a cookie or forbids caching with `Cache-Control`. A separate cache can hold
+  the decisions of an authorizer for requests of any method. Lookups are done by the connection thread, so a cached
+  response is answered without launching a thread.
+ */
+class response_cache
+{
+public:
+	typedef std::chrono::steady_clock clock_type;
+
+	struct statistics
+	{
+		/** fresh responses served from the cache */
+		std::size_t hits;
+		/** expired responses served while revalidating */
+		std::size_t stale_hits;
+		std::size_t misses;
+		std::size_t stores;
+		std::size_t evictions;
+		std::size_t entries;
+		/** the size of all cached responses in bytes */
+		std::size_t size;
+	};
+
+	struct entry
+	{
+		std::string content;
+		detail::quadruple_type app_status;
+		clock_type::time_point expires;
+		clock_type::time_point stale_until;
+	};
+
+	enum class LOOKUP
+	{
+		/** nothing usable is cached */
+		miss,
+		/** the entry is fresh */
+		hit,
+		/** the entry is stale and the caller must revalidate it */
+		revalidate,
+		/** the entry is stale and is already being revalidated */
+		stale
+	};
+
+	/**
+	  Creates a new cache.
+
+	  @param keys the parameters identifying a response, e.g. `HTTP_HOST`, `REQUEST_URI` and `QUERY_STRING`
+	  @param ttl how long a response is fresh
+	  @param stale how long an expired response may still be served while it is revalidated
+	  @param max_size the maximum size of all cached responses in bytes
+	 */
+	response_cache(std::vector<std::string> keys, std::chrono::milliseconds ttl, std::chrono::milliseconds stale,
+	               std::size_t max_size);
+	response_cache(const response_cache& copy) = delete;
+	/**
+	  Checks whether the response of a request with these parameters may be cached.
+	 */
+	static bool cacheable(const detail::params& params);
+	/**
+	  Checks whether the response of a responder may be stored. Only heuristically cacheable statuses like 200, 301
+	  and 404 are stored. If the request carries an `Authorization` or `Cookie` header that is not part of the key,
+	  the response must be marked `public` with `Cache-Control`. Every request header named by `Vary` must be part of
+	  the key; `Vary: *` is never stored.
+
+	  @param params the parameters of the request
+	  @param content the complete output of the role
+	  @param encoding_keyed whether the negotiated content encoding is part of the key, which covers
+	                        `Vary: Accept-Encoding`
+	 */
+	bool storable(const detail::params& params, const std::string& content, bool encoding_keyed = false) const;
+	/**
+	  Checks whether the output of an authorizer is a decision that may be stored. Only grants with status 200 and
+	  denials with status 401 or 403 are stored.
+
+	  @param content the complete output of the role
+	 */
+	static bool storable_decision(const std::string& content);
+	/**
+	  Creates the cache key of the request.
+	 */
+	std::string make_key(const detail::params& params) const;
+	std::pair<LOOKUP, std::shared_ptr<const entry>> find(const std::string& key);
+	/**
+	  Stores a response. Responses that are too large or that must not be cached are ignored. Storing a response also
+	  ends a pending revalidation.
+
+	  @param key the cache key
+	  @param content the complete output of the role
+	  @param app_status the status code of the role
+	 */
+	void store(const std::string& key, std::string content, detail::quadruple_type app_status);
+	/**
+	  Ends a pending revalidation without storing a new response.
+	 */
+	void abandon(const std::string& key);
+	void clear();
+	statistics stats() const;
+	std::size_t max_size() const noexcept;
+
+private:
+	struct node
+	{
+		std::shared_ptr<const entry> value;
+		std::list<std::string>::iterator position;
+		bool revalidating;
+	};
+
+	std::vector<std::string> _keys;
+	std::chrono::milliseconds _ttl;
+	std::chrono::milliseconds _stale;
+	std::size_t _max_size;
+	mutable std::mutex _mutex;
+	std::unordered_map<std::string, node> _entries;
+	/** the keys in least recently used order */
+	std::list<std::string> _order;
+	statistics _statistics;
+
+	void _erase(std::unordered_map<std::string, node>::iterator entry);
+};
+
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -1,14 +1,20 @@
 #ifndef FASST_CGI_ROLE_HPP_
 #define FASST_CGI_ROLE_HPP_
 
+#include "detail/cancellation.hpp"
 #include "detail/config.hpp"
 #include "detail/params.hpp"
 #include "exception/invalid_role_error.hpp"
 #include "io/byte_stream.hpp"
+#include "io/format.hpp"
+#include "memory/arena.hpp"
 
-#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <type_traits>
+#include <utility>
 
 namespace fast_cgi {
 namespace detail {
@@ -24,20 +30,48 @@ public:
 
 	role() noexcept
 	{
-		_cancelled     = nullptr;
-		_output_stream = nullptr;
-		_error_stream  = nullptr;
+		_cancelled         = nullptr;
+		_arena             = nullptr;
+		_output_stream     = nullptr;
+		_output_buffer     = nullptr;
+		_error_stream      = nullptr;
+		_initial_page_size = 0;
+		_max_page_size     = std::numeric_limits<std::size_t>::max();
+		_flush_on_sync     = false;
 	}
 	virtual ~role() = default;
 	/**
 	  Executes this role
 	 */
 	virtual status_code_type run() = 0;
+	/**
+	  Returns whether the request was aborted by the web server or the connection was lost. The output of a cancelled
+	  request is discarded.
+	 */
 	bool is_cancelled() const volatile noexcept
 	{
-		return _cancelled->load(std::memory_order_acquire);
+		return _cancelled->cancelled();
 	}
-	const std::string& params(const std::string& key) const
+	/**
+	  Sets a callback that is called once when the request is cancelled, for example to wake up a blocked computation.
+	  Blocked reads of `input()` and `data()` fail on their own. The callback is called from the connection thread and
+	  should return quickly; if the request is already cancelled, it is called immediately. It is removed after `run()`
+	  returned.
+
+	  @param callback the callback; replaces the previous one
+	 */
+	void on_cancel(std::function<void()> callback)
+	{
+		_cancelled->set_callback(std::move(callback));
+	}
+	/**
+	  Returns the value of a parameter. The value stays valid until the request ends.
+
+	  @param key the name of the parameter
+	  @returns the value
+	  @throws std::out_of_range if the parameter does not exist
+	 */
+	string_view params(string_view key) const
 	{
 		return (*_params)[key];
 	}
@@ -54,18 +88,91 @@ public:
 	{
 		return *_output_stream;
 	}
+	/**
+	  Returns the buffer behind `output()`. Writing to the buffer directly avoids the formatting of the stream; both
+	  can be mixed freely.
+
+	  @returns a reference to the output buffer
+	 */
+	io::output_streambuf& output_buffer() noexcept
+	{
+		return *_output_buffer;
+	}
+	/**
+	  Formats the arguments directly into the output buffer without consulting the locale. Every `{}` is replaced by
+	  the next argument.
+
+	  @param format the format string
+	  @param args the arguments
+	  @throws exception::format_error if the format string is invalid
+	 */
+	template<typename... Args>
+	void format(const char* format, const Args&... args)
+	{
+		io::format(*_output_buffer, format, args...);
+	}
 	io::byte_ostream& error() noexcept
 	{
 		return *_error_stream;
 	}
+	/**
+	  Returns the arena of the request. Everything allocated in it is freed at once after the role finished; the arena
+	  may only be used by the thread executing the role.
+
+	  @returns a reference to the arena
+	 */
+	memory::arena& arena() noexcept
+	{
+		return *_arena;
+	}
+	/**
+	  Sets the size of the output pages. Every page is sent as one record and the page size doubles with every page.
+	  Sizes are rounded up to the next size class and limited by the largest class, which still fits into one record.
+	  Small pages save memory for short responses while large pages reduce the amount of records of long responses.
+
+	  @param initial the size of the first page
+	  @param max the maximum page size
+	 */
+	void set_page_size(std::size_t initial, std::size_t max) noexcept
+	{
+		_initial_page_size = initial;
+		_max_page_size     = max;
+	}
+	/**
+	  Sends everything written to `output()` so far to the web server, for example before a long computation or
+	  between streamed events. Unlike `std::flush` this always creates a record.
+	 */
+	void flush()
+	{
+		_output_buffer->flush();
+	}
+	/**
+	  Sets whether `std::flush` and `std::endl` send the output like `flush()`. By default they are ignored and the
+	  output is only sent when a page is full or the role finished.
+
+	  @param enable whether to flush on every sync
+	 */
+	void set_flush_on_sync(bool enable) noexcept
+	{
+		_flush_on_sync = enable;
+
+		if (_output_buffer) {
+			_output_buffer->set_flush_on_sync(enable);
+		}
+	}
 
 private:
 	friend detail::request_manager;
 
-	std::atomic_bool* _cancelled;
+	detail::cancellation* _cancelled;
+	memory::arena* _arena;
 	detail::params* _params;
 	io::byte_ostream* _output_stream;
+	io::output_streambuf* _output_buffer;
 	io::byte_ostream* _error_stream;
+	std::size_t _initial_page_size;
+	std::size_t _max_page_size;
+	bool _flush_on_sync;
 };
 
 class responder : public virtual role
@@ -115,6 +222,27 @@ private:
 	io::byte_istream* _data_stream;
 };
 
+namespace detail {
+
+typedef std::unique_ptr<role, void (*)(role*)> role_pointer;
+
+/**
+  Creates a new role. If an arena is given the role is placed in it and only destroyed, not freed.
+
+  @param arena the arena of the request; may be `nullptr`
+  @returns the role
+ */
+template<typename T>
+inline role_pointer make_role(memory::arena* arena)
+{
+	if (arena) {
+		return role_pointer(new (arena->allocate(sizeof(T), alignof(T))) T(), [](role* r) { r->~role(); });
+	}
+
+	return role_pointer(new T(), [](role* r) { delete r; });
+}
+
+} // namespace detail
 } // namespace fast_cgi
 
 #endif
\ No newline at end of file
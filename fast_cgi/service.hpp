@@ -6,6 +6,8 @@
 #include "io/input_manager.hpp"
 #include "io/reader.hpp"
 #include "memory/allocator.hpp"
+#include "memory/governor.hpp"
+#include "response_cache.hpp"
 #include "role.hpp"
 
 #include <array>
@@ -21,22 +23,76 @@ class service
 {
 public:
 	service(std::shared_ptr<connector> connector, std::shared_ptr<memory::allocator> allocator);
+	/**
+	  Registers the role answering the requests of its type. A filter only answers filter requests.
+
+	  @tparam T a subclass of `responder`, `authorizer` or `filter`
+	 */
 	template<typename T>
 	typename std::enable_if<std::is_base_of<role, T>::value>::type set_role()
 	{
-		if (std::is_base_of<responder, T>::value) {
-			_role_factories[0] = [] { return std::unique_ptr<role>(new T()); };
+		auto factory = [](memory::arena* arena) { return detail::make_role<T>(arena); };
+
+		// the index is the role type of the request minus one
+		if (std::is_base_of<filter, T>::value) {
+			_role_factories[2] = factory;
+		} else if (std::is_base_of<responder, T>::value) {
+			_role_factories[0] = factory;
+		}
+
+		if (std::is_base_of<authorizer, T>::value) {
+			_role_factories[1] = factory;
 		}
 	}
+	/**
+	  Enables compression of the responder output if the web server accepts `gzip` or `deflate` encoding. Compression
+	  is only available if the library was built with zlib.
+
+	  @param level the zlib compression level from 1 to 9; 0 disables compression
+	 */
+	void set_compression_level(int level) noexcept;
+	/**
+	  Sets the cache for responder outputs. Cached responses are answered without executing the role.
+
+	  @param cache the cache; may be `nullptr` to disable caching
+	 */
+	void set_response_cache(std::shared_ptr<response_cache> cache) noexcept;
+	/**
+	  Sets the cache for authorizer decisions. A cached decision is answered by the connection thread as soon as the
+	  parameters arrived, without executing the role. The keys of the cache should identify the client, e.g.
+	  `HTTP_AUTHORIZATION` or `REMOTE_ADDR`; the stale period is not used.
+
+	  @param cache the cache; may be `nullptr` to disable caching
+	 */
+	void set_authorizer_cache(std::shared_ptr<response_cache> cache) noexcept;
+	/**
+	  Sets the governor accounting the memory of all connections. While its limit is exceeded new requests are rejected
+	  with `FCGI_OVERLOADED` and reading and writing is throttled.
+
+	  @param governor the governor; may be `nullptr` to disable the limit
+	 */
+	void set_governor(std::shared_ptr<memory::governor> governor) noexcept;
+	/**
+	  Sets the maximum amount of input read from a connection before it was processed. The connection is not read
+	  while the limit is reached. The default is `io::input_manager::default_capacity`.
+
+	  @param size the limit in bytes
+	 */
+	void set_connection_buffer_size(std::size_t size) noexcept;
 	void run();
 	void join();
 
 private:
 	detail::VERSION _version;
+	int _compression_level;
+	std::size_t _connection_buffer_size;
 	std::shared_ptr<connector> _connector;
 	std::vector<std::thread> _connections;
 	std::shared_ptr<memory::allocator> _allocator;
-	std::array<std::function<std::unique_ptr<role>()>, 3> _role_factories;
+	std::shared_ptr<response_cache> _response_cache;
+	std::shared_ptr<response_cache> _authorizer_cache;
+	std::shared_ptr<memory::governor> _governor;
+	std::array<std::function<detail::role_pointer(memory::arena*)>, 3> _role_factories;
 
 	void _connection_thread(std::shared_ptr<connection> connection);
 	void _input_handler(std::shared_ptr<io::reader> reader, std::shared_ptr<io::output_manager> output_manager);
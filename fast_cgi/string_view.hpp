@@ -0,0 +1,135 @@
+#ifndef FAST_CGI_STRING_VIEW_HPP_
+#define FAST_CGI_STRING_VIEW_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace fast_cgi {
+
+/**
+  A non-owning reference to a sequence of characters. The referenced characters are not null-terminated.
+ */
+class string_view
+{
+public:
+	typedef const char* const_iterator;
+	typedef std::size_t size_type;
+
+	constexpr static size_type npos = static_cast<size_type>(-1);
+
+	constexpr string_view() noexcept : _data(nullptr), _size(0)
+	{}
+	constexpr string_view(const char* data, size_type size) noexcept : _data(data), _size(size)
+	{}
+	string_view(const char* string) noexcept : _data(string), _size(std::strlen(string))
+	{}
+	string_view(const std::string& string) noexcept : _data(string.data()), _size(string.size())
+	{}
+	constexpr const char* data() const noexcept
+	{
+		return _data;
+	}
+	constexpr size_type size() const noexcept
+	{
+		return _size;
+	}
+	constexpr size_type length() const noexcept
+	{
+		return _size;
+	}
+	constexpr bool empty() const noexcept
+	{
+		return _size == 0;
+	}
+	constexpr const_iterator begin() const noexcept
+	{
+		return _data;
+	}
+	constexpr const_iterator end() const noexcept
+	{
+		return _data + _size;
+	}
+	constexpr char operator[](size_type index) const noexcept
+	{
+		return _data[index];
+	}
+	/**
+	  Returns a part of this view.
+
+	  @param offset the first character
+	  @param count the maximum amount of characters
+	  @returns the part
+	  @throws std::out_of_range if *offset* is larger than the size
+	 */
+	string_view substr(size_type offset, size_type count = npos) const
+	{
+		if (offset > _size) {
+			throw std::out_of_range("offset out of range");
+		}
+
+		return { _data + offset, std::min(count, _size - offset) };
+	}
+	size_type find(char c, size_type offset = 0) const noexcept
+	{
+		if (offset < _size) {
+			if (auto ptr = static_cast<const char*>(std::memchr(_data + offset, c, _size - offset))) {
+				return static_cast<size_type>(ptr - _data);
+			}
+		}
+
+		return npos;
+	}
+	int compare(string_view other) const noexcept
+	{
+		auto result = _size && other._size ? std::memcmp(_data, other._data, std::min(_size, other._size)) : 0;
+
+		if (result) {
+			return result;
+		}
+
+		return _size < other._size ? -1 : (_size > other._size ? 1 : 0);
+	}
+	std::string to_string() const
+	{
+		return { _data, _size };
+	}
+	/**
+	  Copies the referenced characters. This conversion keeps code working that expects a `std::string`.
+	 */
+	operator std::string() const
+	{
+		return to_string();
+	}
+
+private:
+	const char* _data;
+	size_type _size;
+};
+
+inline bool operator==(string_view left, string_view right) noexcept
+{
+	return left.size() == right.size() && left.compare(right) == 0;
+}
+
+inline bool operator!=(string_view left, string_view right) noexcept
+{
+	return !(left == right);
+}
+
+inline bool operator<(string_view left, string_view right) noexcept
+{
+	return left.compare(right) < 0;
+}
+
+inline std::ostream& operator<<(std::ostream& stream, string_view view)
+{
+	return stream.write(view.data(), static_cast<std::streamsize>(view.size()));
+}
+
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
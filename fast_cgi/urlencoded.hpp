@@ -0,0 +1,84 @@
+#ifndef FAST_CGI_URLENCODED_HPP_
+#define FAST_CGI_URLENCODED_HPP_
+
+#include "memory/arena.hpp"
+#include "string_view.hpp"
+
+#include <cstddef>
+#include <istream>
+#include <utility>
+#include <vector>
+
+namespace fast_cgi {
+
+/**
+  Parses `application/x-www-form-urlencoded` content like query strings and form bodies. The content is copied into
+  an owned buffer and decoded in place; names and values are views into this buffer and stay valid until the parser is
+  destroyed or parses again. The buffer is allocated in the given arena, which is usually the arena of the request.
+
+  Pairs are kept in the order they were sent and names may occur multiple times. Empty pairs are skipped and a pair
+  without `=` has an empty value.
+ */
+class urlencoded
+{
+public:
+	typedef std::pair<string_view, string_view> value_type;
+	typedef std::vector<value_type, memory::arena_allocator<value_type>> pairs_type;
+	typedef pairs_type::const_iterator const_iterator;
+
+	/**
+	  Creates an empty parser.
+
+	  @param[in] arena the arena of the buffer; if `nullptr` the heap is used
+	 */
+	urlencoded(memory::arena* arena = nullptr);
+	urlencoded(urlencoded&& move) = default;
+	urlencoded(const urlencoded& copy) = delete;
+	urlencoded& operator=(urlencoded&& move) = default;
+	urlencoded& operator=(const urlencoded& copy) = delete;
+	/**
+	  Parses the content. All previous pairs are removed.
+
+	  @param content the encoded content, for example the query string
+	 */
+	void parse(string_view content);
+	/**
+	  Reads the stream until its end and parses the content. All previous pairs are removed.
+
+	  @param[in] input the stream, for example the input of the role
+	 */
+	void parse(std::istream& input);
+	const_iterator begin() const noexcept;
+	const_iterator end() const noexcept;
+	std::size_t size() const noexcept;
+	bool has(string_view name) const noexcept;
+	/**
+	  Returns the value of the first pair with the name.
+
+	  @param name the decoded name
+	  @returns the decoded value
+	  @throws std::out_of_range if no pair with the name exists
+	 */
+	string_view operator[](string_view name) const;
+	/**
+	  Decodes percent-encoded bytes and `+` in place. Invalid escape sequences are kept unchanged.
+
+	  @param[in,out] data the encoded data
+	  @param size the size of *data*
+	  @returns the decoded size
+	 */
+	static std::size_t decode(char* data, std::size_t size) noexcept;
+
+private:
+	std::vector<char, memory::arena_allocator<char>> _data;
+	pairs_type _pairs;
+
+	/**
+	  Splits and decodes the buffer in place.
+	 */
+	void _parse();
+};
+
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -1,50 +1,673 @@
 #include "fast_cgi/detail/params.hpp"
-#include "fast_cgi/exception/io_error.hpp"
 #include "fast_cgi/log.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
 namespace fast_cgi {
 namespace detail {
 
-params::map_type::const_iterator params::begin() const
+namespace {
+
+/** the initial capacities avoid regrowing in the arena for typical requests */
+constexpr std::size_t initial_data_size  = 2048;
+constexpr std::size_t initial_index_size = 32;
+
+/** the names of the standard variables in the order of `params::VARIABLE` */
+constexpr const char* variable_names[] = { "AUTH_TYPE",
+	                                       "CONTENT_LENGTH",
+	                                       "CONTENT_TYPE",
+	                                       "DOCUMENT_ROOT",
+	                                       "DOCUMENT_URI",
+	                                       "GATEWAY_INTERFACE",
+	                                       "HTTPS",
+	                                       "HTTP_ACCEPT",
+	                                       "HTTP_ACCEPT_ENCODING",
+	                                       "HTTP_ACCEPT_LANGUAGE",
+	                                       "HTTP_AUTHORIZATION",
+	                                       "HTTP_COOKIE",
+	                                       "HTTP_HOST",
+	                                       "HTTP_REFERER",
+	                                       "HTTP_USER_AGENT",
+	                                       "PATH_INFO",
+	                                       "PATH_TRANSLATED",
+	                                       "QUERY_STRING",
+	                                       "REMOTE_ADDR",
+	                                       "REMOTE_HOST",
+	                                       "REMOTE_PORT",
+	                                       "REMOTE_USER",
+	                                       "REQUEST_METHOD",
+	                                       "REQUEST_SCHEME",
+	                                       "REQUEST_URI",
+	                                       "SCRIPT_FILENAME",
+	                                       "SCRIPT_NAME",
+	                                       "SERVER_ADDR",
+	                                       "SERVER_NAME",
+	                                       "SERVER_PORT",
+	                                       "SERVER_PROTOCOL",
+	                                       "SERVER_SOFTWARE",
+	                                       "FCGI_DATA_LENGTH" };
+
+static_assert(sizeof(variable_names) / sizeof(*variable_names) == params::variable_count, "missing variable name");
+
+/*
+  The slot of a name is a hash of its length, its first, middle and last two characters. The seed was chosen so that
+  all standard names have a distinct slot, which is verified below.
+ */
+constexpr std::size_t slot_bits    = 7;
+constexpr std::size_t slot_count   = std::size_t(1) << slot_bits;
+constexpr std::uint32_t slot_seed  = 86;
+constexpr std::uint8_t no_variable = 0xff;
+
+constexpr std::uint32_t mix(std::uint32_t hash, std::uint32_t value) noexcept
+{
+	return (hash ^ value) * std::uint32_t(16777619);
+}
+
+constexpr std::uint32_t character(const char* name, std::size_t index) noexcept
+{
+	return static_cast<unsigned char>(name[index]);
+}
+
+/**
+  Returns the slot of a name with at least two characters.
+ */
+constexpr std::size_t slot_of(const char* name, std::size_t length) noexcept
+{
+	return mix(mix(mix(mix(mix(slot_seed, static_cast<std::uint32_t>(length)), character(name, 0)),
+	                   character(name, length / 2)),
+	               character(name, length - 2)),
+	           character(name, length - 1)) >>
+	       (32 - slot_bits);
+}
+
+constexpr std::size_t length_of(const char* name) noexcept
+{
+	return *name ? 1 + length_of(name + 1) : 0;
+}
+
+constexpr std::size_t variable_slot(std::size_t variable) noexcept
+{
+	return slot_of(variable_names[variable], length_of(variable_names[variable]));
+}
+
+constexpr bool distinct_from(std::size_t variable, std::size_t other) noexcept
+{
+	return other == params::variable_count ||
+	       (variable_slot(variable) != variable_slot(other) && distinct_from(variable, other + 1));
+}
+
+constexpr bool perfect(std::size_t variable) noexcept
+{
+	return variable == params::variable_count || (distinct_from(variable, variable + 1) && perfect(variable + 1));
+}
+
+static_assert(perfect(0), "the slots of the standard variables collide; choose another seed");
+static_assert(params::variable_count < no_variable, "too many variables");
+
+std::array<std::uint8_t, slot_count> make_slot_table() noexcept
+{
+	std::array<std::uint8_t, slot_count> table;
+
+	table.fill(no_variable);
+
+	for (std::size_t i = 0; i < params::variable_count; ++i) {
+		table[variable_slot(i)] = static_cast<std::uint8_t>(i);
+	}
+
+	return table;
+}
+
+const std::array<std::uint8_t, slot_count> slot_table = make_slot_table();
+
+/**
+  Looks up the standard variable of a name.
+
+  @returns the variable or `no_variable`
+ */
+std::size_t variable_of(const char* name, std::size_t length) noexcept
+{
+	if (length < 2) {
+		return no_variable;
+	}
+
+	auto variable = slot_table[slot_of(name, length)];
+
+	if (variable != no_variable && length_of(variable_names[variable]) == length &&
+	    std::memcmp(variable_names[variable], name, length) == 0) {
+		return variable;
+	}
+
+	return no_variable;
+}
+
+/**
+  Parses a decimal length.
+
+  @returns `false` if the value is not a number or too large
+ */
+bool parse_size(string_view value, std::uint64_t& size) noexcept
+{
+	constexpr auto max = std::numeric_limits<std::uint64_t>::max();
+
+	size = 0;
+
+	for (auto c : value) {
+		if (c < '0' || c > '9' || size > (max - (c - '0')) / 10) {
+			size = 0;
+
+			return false;
+		}
+
+		size = size * 10 + (c - '0');
+	}
+
+	return !value.empty();
+}
+
+params::METHOD parse_method(string_view value) noexcept
+{
+	constexpr std::pair<const char*, params::METHOD> methods[] = { { "GET", params::METHOD::GET },
+		                                                           { "HEAD", params::METHOD::HEAD },
+		                                                           { "POST", params::METHOD::POST },
+		                                                           { "PUT", params::METHOD::PUT },
+		                                                           { "DELETE", params::METHOD::DELETE },
+		                                                           { "CONNECT", params::METHOD::CONNECT },
+		                                                           { "OPTIONS", params::METHOD::OPTIONS },
+		                                                           { "TRACE", params::METHOD::TRACE },
+		                                                           { "PATCH", params::METHOD::PATCH } };
+
+	for (auto& method : methods) {
+		if (value == method.first) {
+			return method.second;
+		}
+	}
+
+	return params::METHOD::UNKNOWN;
+}
+
+constexpr auto header_prefix        = "HTTP_";
+constexpr std::size_t prefix_length = 5;
+
+/** header names are compared case-insensitively and `-` matches `_` */
+inline char normalize(char c) noexcept
+{
+	return c == '-' ? '_' : c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+std::uint32_t header_hash(const char* name, std::size_t length) noexcept
+{
+	std::uint32_t hash = 2166136261;
+
+	for (auto end = name + length; name != end; ++name) {
+		hash = (hash ^ static_cast<unsigned char>(normalize(*name))) * std::uint32_t(16777619);
+	}
+
+	return hash;
+}
+
+bool header_equals(const char* left, const char* right, std::size_t length) noexcept
+{
+	for (auto end = left + length; left != end; ++left, ++right) {
+		if (normalize(*left) != normalize(*right)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool header_equals(string_view name, string_view variable) noexcept
+{
+	return name.size() == variable.size() && header_equals(name.data(), variable.data(), name.size());
+}
+
+} // namespace
+
+params::params() noexcept : _sorted(true), _slots(), _content_size(0), _data_size(0), _method(METHOD::UNKNOWN),
+      _cookies_indexed(false)
+{}
+
+params::const_iterator params::begin() const noexcept
+{
+	_sort();
+
+	return { this, 0 };
+}
+
+params::const_iterator params::end() const noexcept
+{
+	_sort();
+
+	return { this, _index.size() };
+}
+
+std::size_t params::size() const noexcept
+{
+	_sort();
+
+	return _index.size();
+}
+
+bool params::has(string_view key) const noexcept
+{
+	return _find(key) != nullptr;
+}
+
+string_view params::operator[](string_view key) const
+{
+	if (auto e = _find(key)) {
+		return { _data.data() + e->value, e->value_length };
+	}
+
+	throw std::out_of_range("parameter does not exist");
+}
+
+bool params::has(VARIABLE variable) const noexcept
+{
+	return _slots[static_cast<std::size_t>(variable)].name_length != 0;
+}
+
+string_view params::get(VARIABLE variable) const noexcept
+{
+	auto& e = _slots[static_cast<std::size_t>(variable)];
+
+	return e.name_length ? string_view(_data.data() + e.value, e.value_length) : string_view();
+}
+
+std::uint64_t params::content_size() const noexcept
+{
+	return _content_size;
+}
+
+std::uint64_t params::data_size() const noexcept
+{
+	return _data_size;
+}
+
+params::METHOD params::method() const noexcept
+{
+	return _method;
+}
+
+string_view params::header(string_view name) const noexcept
+{
+	// not sent as HTTP_* variables
+	if (header_equals(name, "CONTENT_TYPE")) {
+		return get(VARIABLE::content_type);
+	} else if (header_equals(name, "CONTENT_LENGTH")) {
+		return get(VARIABLE::content_length);
+	} else if (auto e = _find_header(name)) {
+		return { _data.data() + e->value, e->value_length };
+	}
+
+	return {};
+}
+
+bool params::has_header(string_view name) const noexcept
+{
+	if (header_equals(name, "CONTENT_TYPE")) {
+		return has(VARIABLE::content_type);
+	} else if (header_equals(name, "CONTENT_LENGTH")) {
+		return has(VARIABLE::content_length);
+	}
+
+	return _find_header(name) != nullptr;
+}
+
+string_view params::cookie(string_view name) const
+{
+	if (auto e = _find_cookie(name)) {
+		return { _data.data() + e->value, e->value_length };
+	}
+
+	return {};
+}
+
+bool params::has_cookie(string_view name) const
+{
+	return _find_cookie(name) != nullptr;
+}
+
+params::map_type params::to_map() const
+{
+	map_type map;
+
+	for (auto& parameter : *this) {
+		map.insert({ parameter.first, parameter.second });
+	}
+
+	return map;
+}
+
+const params::entry* params::_find(string_view key) const noexcept
 {
-	return _parameters.begin();
+	auto variable = variable_of(key.data(), key.size());
+
+	if (variable != no_variable) {
+		return _slots[variable].name_length ? &_slots[variable] : nullptr;
+	}
+
+	_sort();
+
+	auto data = _data.data();
+	auto e    = std::lower_bound(_index.begin(), _index.end(), key, [data](const entry& e, string_view key) {
+        return string_view(data + e.name, e.name_length) < key;
+    });
+
+	if (e != _index.end() && string_view(data + e->name, e->name_length) == key) {
+		return &*e;
+	}
+
+	return nullptr;
 }
 
-params::map_type::const_iterator params::end() const
+const params::entry* params::_find_header(string_view name) const noexcept
 {
-	return _parameters.end();
+	if (_headers.empty()) {
+		return nullptr;
+	}
+
+	auto data = _data.data();
+	auto mask = _headers.size() - 1;
+
+	for (auto i = header_hash(name.data(), name.size()) & mask;; i = (i + 1) & mask) {
+		auto& e = _headers[i];
+
+		if (!e.name_length) {
+			return nullptr;
+		} else if (e.name_length - prefix_length == name.size() &&
+		           header_equals(data + e.name + prefix_length, name.data(), name.size())) {
+			return &e;
+		}
+	}
 }
 
-bool params::has(const std::string& key) const
+const params::entry* params::_find_cookie(string_view name) const
 {
-	return _parameters.find(key) != _parameters.end();
+	_index_cookies();
+
+	auto data = _data.data();
+	auto e    = std::lower_bound(_cookies.begin(), _cookies.end(), name, [data](const entry& e, string_view name) {
+        return string_view(data + e.name, e.name_length) < name;
+    });
+
+	if (e != _cookies.end() && string_view(data + e->name, e->name_length) == name) {
+		return &*e;
+	}
+
+	return nullptr;
+}
+
+params::value_type params::_pair(std::size_t index) const noexcept
+{
+	if (index >= _index.size()) {
+		return {};
+	}
+
+	auto& e = _index[index];
+
+	return { { _data.data() + e.name, e.name_length }, { _data.data() + e.value, e.value_length } };
+}
+
+void params::_read_parameters(io::reader& reader, memory::arena& arena, const std::atomic<std::size_t>& stream_size)
+{
+	_data  = decltype(_data)(decltype(_data)::allocator_type(&arena));
+	_index = decltype(_index)(decltype(_index)::allocator_type(&arena));
+
+	_headers = decltype(_headers)(decltype(_headers)::allocator_type(&arena));
+	_cookies = decltype(_cookies)(decltype(_cookies)::allocator_type(&arena));
+
+	// one more byte than announced ends the stream with a short read
+	_data.reserve(std::max(initial_data_size, stream_size.load(std::memory_order_acquire) + 1));
+	_index.reserve(initial_index_size);
+	_slots.fill({});
+
+	_cookies_indexed = false;
+
+	// copy the raw stream in chunks
+	while (true) {
+		auto offset = _data.size();
+
+		// grow to the records that arrived meanwhile; the arena keeps the old block
+		if (offset == _data.capacity()) {
+			auto announced = stream_size.load(std::memory_order_acquire);
+
+			_data.reserve(announced > offset ? announced + 1 : offset * 2);
+		}
+
+		_data.resize(_data.capacity());
+
+		auto size = reader.read(_data.data() + offset, _data.size() - offset);
+
+		_data.resize(offset + size);
+
+		if (offset + size < _data.capacity()) {
+			break;
+		}
+	}
+
+	_index_parameters();
+	_index_headers();
+	_parse_variables();
+
+	FAST_CGI_LOG(DEBUG, "read {} parameters in {} bytes", _index.size(), _data.size());
+}
+
+void params::_index_parameters()
+{
+	auto data   = reinterpret_cast<const std::uint8_t*>(_data.data());
+	auto size   = _data.size();
+	auto offset = std::size_t(0);
+	auto length = [&](std::uint32_t& value) {
+		if (offset >= size) {
+			return false;
+		} else if (!(data[offset] & 0x80)) {
+			value = data[offset++];
+
+			return true;
+		} else if (size - offset < 4) {
+			return false;
+		}
+
+		value = ((data[offset] & 0x7fu) << 24) | (data[offset + 1] << 16) | (data[offset + 2] << 8) | data[offset + 3];
+		offset += 4;
+
+		return true;
+	};
+
+	while (offset < size) {
+		entry e;
+
+		if (!length(e.name_length) || !length(e.value_length) ||
+		    size - offset < std::uint64_t(e.name_length) + e.value_length) {
+			FAST_CGI_LOG(WARN, "truncated parameter at offset {}", offset);
+
+			break;
+		}
+
+		e.name  = static_cast<std::uint32_t>(offset);
+		e.value = static_cast<std::uint32_t>(offset + e.name_length);
+		offset += e.name_length + e.value_length;
+
+		_index.push_back(e);
+
+		// the last value of a name wins
+		auto variable = variable_of(_data.data() + e.name, e.name_length);
+
+		if (variable != no_variable) {
+			_slots[variable] = e;
+		}
+	}
+
+	_sorted = false;
 }
 
-const std::string& params::operator[](const std::string& key) const
+void params::_index_headers()
 {
-	return _parameters.at(key);
+	auto data      = _data.data();
+	auto is_header = [data](const entry& e) {
+		return e.name_length > prefix_length && std::memcmp(data + e.name, header_prefix, prefix_length) == 0;
+	};
+	auto count = static_cast<std::size_t>(std::count_if(_index.begin(), _index.end(), is_header));
+
+	if (!count) {
+		return;
+	}
+
+	// at most half full
+	std::size_t size = 8;
+
+	while (size < count * 2) {
+		size *= 2;
+	}
+
+	_headers.assign(size, entry{});
+
+	// the index is still in the order of the block, so the last value of a name wins
+	for (auto& e : _index) {
+		if (!is_header(e)) {
+			continue;
+		}
+
+		auto name   = data + e.name + prefix_length;
+		auto length = e.name_length - prefix_length;
+
+		for (auto i = header_hash(name, length) & (size - 1);; i = (i + 1) & (size - 1)) {
+			auto& bucket = _headers[i];
+
+			if (!bucket.name_length ||
+			    (bucket.name_length == e.name_length && header_equals(data + bucket.name + prefix_length, name, length))) {
+				bucket = e;
+
+				break;
+			}
+		}
+	}
 }
 
-void params::_read_parameters(io::reader& reader)
+void params::_index_cookies() const
 {
-	try {
-		while (true) {
-			auto pair = detail::name_value_pair::read(reader);
-			std::string name;
-			std::string value;
+	if (_cookies_indexed) {
+		return;
+	}
+
+	_cookies_indexed = true;
 
-			name.resize(pair.name_length);
-			reader.read(&*name.begin(), pair.name_length);
+	auto& cookies = _slots[static_cast<std::size_t>(VARIABLE::http_cookie)];
+
+	if (!cookies.name_length) {
+		return;
+	}
 
-			value.resize(pair.value_length);
-			reader.read(&*value.begin(), pair.value_length);
+	// name=value; name2=value2
+	auto data     = _data.data();
+	auto position = cookies.value;
+	auto end      = cookies.value + cookies.value_length;
+	auto is_space = [data](std::uint32_t i) { return data[i] == ' ' || data[i] == '\t'; };
 
-			FAST_CGI_LOG(DEBUG, "read parameter: {}={}", name, value);
+	while (position < end) {
+		auto token_end = static_cast<std::uint32_t>(std::find(data + position, data + end, ';') - data);
+		auto equals    = static_cast<std::uint32_t>(std::find(data + position, data + token_end, '=') - data);
 
-			_parameters[std::move(name)].swap(value);
+		if (equals != token_end) {
+			auto name_begin  = position;
+			auto name_end    = equals;
+			auto value_begin = equals + 1;
+			auto value_end   = token_end;
+
+			while (name_begin < name_end && is_space(name_begin)) {
+				++name_begin;
+			}
+
+			while (name_end > name_begin && is_space(name_end - 1)) {
+				--name_end;
+			}
+
+			while (value_begin < value_end && is_space(value_begin)) {
+				++value_begin;
+			}
+
+			while (value_end > value_begin && is_space(value_end - 1)) {
+				--value_end;
+			}
+
+			if (value_end - value_begin >= 2 && data[value_begin] == '"' && data[value_end - 1] == '"') {
+				++value_begin;
+				--value_end;
+			}
+
+			if (name_end != name_begin) {
+				_cookies.push_back({ name_begin, name_end - name_begin, value_begin, value_end - value_begin });
+			}
 		}
-	} catch (const exception::io_error& e) {
+
+		position = token_end + 1;
+	}
+
+	// the first value of a name wins
+	std::stable_sort(_cookies.begin(), _cookies.end(), [data](const entry& left, const entry& right) {
+		return string_view(data + left.name, left.name_length) < string_view(data + right.name, right.name_length);
+	});
+}
+
+void params::_sort() const noexcept
+{
+	if (_sorted) {
+		return;
 	}
+
+	// sort by name; equal names stay in the order they were sent
+	auto data = _data.data();
+
+	std::sort(_index.begin(), _index.end(), [data](const entry& left, const entry& right) {
+		auto result = string_view(data + left.name, left.name_length).compare({ data + right.name, right.name_length });
+
+		return result < 0 || (result == 0 && left.name < right.name);
+	});
+
+	// the last value of a name wins
+	auto last = std::unique(_index.rbegin(), _index.rend(), [data](const entry& left, const entry& right) {
+		return string_view(data + left.name, left.name_length) == string_view(data + right.name, right.name_length);
+	});
+
+	_index.erase(_index.begin(), last.base());
+
+	_sorted = true;
+}
+
+void params::_parse_variables() noexcept
+{
+	auto content_length = get(VARIABLE::content_length);
+	auto data_length    = get(VARIABLE::fcgi_data_length);
+
+	if (!parse_size(content_length, _content_size) && !content_length.empty()) {
+		FAST_CGI_LOG(WARN, "failed to parse content length ({})", content_length.to_string());
+	}
+
+	if (!parse_size(data_length, _data_size) && !data_length.empty()) {
+		FAST_CGI_LOG(WARN, "failed to parse data content length ({})", data_length.to_string());
+	}
+
+	_method = parse_method(get(VARIABLE::request_method));
+}
+
+void params::_clear() noexcept
+{
+	decltype(_data)().swap(_data);
+	decltype(_index)().swap(_index);
+	decltype(_headers)().swap(_headers);
+	decltype(_cookies)().swap(_cookies);
+	_slots.fill({});
+
+	_cookies_indexed = false;
+
+	_sorted       = true;
+	_content_size = 0;
+	_data_size    = 0;
+	_method       = METHOD::UNKNOWN;
 }
 
 } // namespace detail
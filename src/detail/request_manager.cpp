@@ -1,25 +1,44 @@
 #include "fast_cgi/detail/params.hpp"
 #include "fast_cgi/detail/request_manager.hpp"
+#include "fast_cgi/exception/interrupted_error.hpp"
+#include "fast_cgi/io/compressor.hpp"
 #include "fast_cgi/log.hpp"
 
+#include <algorithm>
+#include <limits>
+
 namespace fast_cgi {
 namespace detail {
 
 request_manager::request_manager(std::shared_ptr<memory::allocator> allocator, std::shared_ptr<io::reader> reader,
-                                 std::array<std::function<std::unique_ptr<role>()>, 3> role_factories)
-    : _terminate_connection(false), _allocator(std::move(allocator)), _reader(std::move(reader)),
-      _role_factories(std::move(role_factories))
-{}
+                                 std::array<role_factory_type, 3> role_factories,
+                                 int compression_level, std::shared_ptr<response_cache> response_cache,
+                                 std::shared_ptr<class response_cache> authorizer_cache,
+                                 std::shared_ptr<memory::governor> governor)
+    : _terminate_connection(false), _compression_level(compression_level), _active(0), _open_requests(0),
+      _allocator(std::move(allocator)), _reader(std::move(reader)), _role_factories(std::move(role_factories)),
+      _response_cache(std::move(response_cache)), _authorizer_cache(std::move(authorizer_cache)),
+      _governor(std::move(governor))
+{
+	if (_governor) {
+		_params_allocator = _governor->track(_allocator, memory::governor::CATEGORY::params);
+		_input_allocator  = _governor->track(_allocator, memory::governor::CATEGORY::input);
+	} else {
+		_params_allocator = _allocator;
+		_input_allocator  = _allocator;
+	}
+}
 
 request_manager::~request_manager()
 {
-	for (auto& request : _requests) {
-		if (request.second->handler_thread.joinable()) {
-			FAST_CGI_LOG(DEBUG, "joining request({}) thread", request.first);
+	std::unique_lock<std::mutex> lock(_mutex);
 
-			request.second->handler_thread.join();
-		}
-	}
+	// the connection is gone -> stop the running roles instead of waiting for them
+	_requests.for_each([](const std::shared_ptr<request>& request) { _abort(*request); });
+
+	FAST_CGI_LOG(DEBUG, "waiting for {} request thread(s)", _active);
+
+	_idle.wait(lock, [this] { return _active == 0; });
 }
 
 bool request_manager::should_terminate_connection() const
@@ -28,13 +47,8 @@ bool request_manager::should_terminate_connection() const
 		return false;
 	}
 
-	for (auto& request : _requests) {
-		if (!request.second->finished.load(std::memory_order_acquire)) {
-			return false;
-		}
-	}
-
-	return true;
+	// finished requests are removed
+	return _open_requests.load(std::memory_order_acquire) == 0;
 }
 
 bool request_manager::handle_request(std::shared_ptr<io::output_manager> output_manager, detail::record record)
@@ -42,26 +56,23 @@ bool request_manager::handle_request(std::shared_ptr<io::output_manager> output_
 	std::shared_ptr<request> request;
 
 	{
-		auto r = _requests.find(record.request_id);
-
-		// request not found
-		if (r != _requests.end()) {
-			// check if request is finished
-			if (r->second->finished.load(std::memory_order_acquire)) {
-				request->handler_thread.join();
-				_requests.erase(r);
-			} else {
-				request = r->second;
-			}
-		}
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		request = _requests.find(record.request_id);
+	}
 
-		// ignore record
-		if ((request && record.type == detail::TYPE::FCGI_BEGIN_REQUEST) ||
-		    (!request && record.type != detail::TYPE::FCGI_BEGIN_REQUEST)) {
-			FAST_CGI_LOG(WARN, "ignoring record because of invalid type and request state (id: {})", record.request_id);
+	// ignore record
+	if (request && record.type == detail::TYPE::FCGI_BEGIN_REQUEST) {
+		FAST_CGI_LOG(WARN, "ignoring record because of invalid type and request state (id: {})", record.request_id);
 
-			return false;
-		}
+		return false;
+	} // the request has already ended -> discard the rest of its streams
+	else if (!request && record.type != detail::TYPE::FCGI_BEGIN_REQUEST) {
+		FAST_CGI_LOG(DEBUG, "discarding record of inactive request (id: {})", record.request_id);
+
+		_reader->skip(record.content_length);
+
+		return true;
 	}
 
 	// do not accept any more new request when connection is queued to be closed
@@ -79,22 +90,35 @@ bool request_manager::handle_request(std::shared_ptr<io::output_manager> output_
 	case detail::TYPE::FCGI_ABORT_REQUEST: {
 		_reader->skip(record.content_length);
 
-		request->cancelled.store(true, std::memory_order_release);
+		FAST_CGI_LOG(INFO, "aborting request {}", record.request_id);
+
+		_abort(*request);
+
+		// no thread ends the request
+		if (_deferred(*request)) {
+			_end_request(request, static_cast<detail::quadruple_type>(-1));
+		}
 
 		break;
 	}
 	case detail::TYPE::FCGI_PARAMS: {
-		_forward_to_buffer(record.content_length, *request->params_buffer);
+		// announced before the content, so the reader can size its block
+		request->params_size.fetch_add(record.content_length, std::memory_order_release);
+		_forward_to_buffer(record.content_length, request->params_buffer.get());
+
+		if (record.content_length == 0 && _deferred(*request)) {
+			_lookup(request);
+		}
 
 		break;
 	}
 	case detail::TYPE::FCGI_DATA: {
-		_forward_to_buffer(record.content_length, *request->data_buffer);
+		_forward_to_buffer(record.content_length, request->data_buffer.get(), request->input_buffer.get());
 
 		break;
 	}
 	case detail::TYPE::FCGI_STDIN: {
-		_forward_to_buffer(record.content_length, *request->input_buffer);
+		_forward_to_buffer(record.content_length, request->input_buffer.get(), request->data_buffer.get());
 
 		break;
 	}
@@ -104,15 +128,25 @@ bool request_manager::handle_request(std::shared_ptr<io::output_manager> output_
 	return true;
 }
 
-void request_manager::_forward_to_buffer(detail::double_type length, memory::buffer& buffer)
+void request_manager::_forward_to_buffer(detail::double_type length, memory::buffer* buffer, memory::buffer* other)
 {
-	// end of stream
-	if (length == 0) {
-		buffer.close();
+	// the role does not receive this stream, stopped reading it or the request was cancelled
+	if (!buffer || buffer->interrupted() || buffer->abandoned()) {
+		_reader->skip(length);
+	} // end of stream
+	else if (length == 0) {
+		buffer->close();
 	} else {
-		auto token = buffer.begin_writing();
+		auto token = buffer->begin_writing();
 
 		for (detail::double_type sent = 0; sent < length;) {
+			// the role stopped reading; the web server may send one stream completely before the other
+			if (!buffer->wait_for_space(other)) {
+				_reader->skip(length - sent);
+
+				break;
+			}
+
 			auto buf = token.request_buffer(length - sent);
 
 			// buffer is full -> ignore
@@ -131,30 +165,45 @@ void request_manager::_forward_to_buffer(detail::double_type length, memory::buf
 	}
 }
 
-void request_manager::_request_hanlder(std::unique_ptr<role> role, std::shared_ptr<request> request)
+void request_manager::_request_hanlder(role_factory_type factory, std::shared_ptr<request> request)
 {
 	auto version = detail::VERSION::FCGI_VERSION_1;
 
-	// read all parameters
-	{
-		io::reader reader(request->params_buffer);
+	// read all parameters unless the connection thread already did
+	try {
+		if (!request->params_ready) {
+			io::reader reader(request->params_buffer);
 
-		FAST_CGI_LOG(DEBUG, "reading all parameters");
+			FAST_CGI_LOG(DEBUG, "reading all parameters");
 
-		request->params._read_parameters(reader);
+			request->params._read_parameters(reader, request->arena, request->params_size);
+		}
 
 		// initialize input buffers
-		std::size_t content_size = 0;
-
-		try {
-			content_size = static_cast<std::size_t>(std::stoull(request->params["CONTENT_LENGTH"]));
-		} catch (const std::exception& e) {
-			FAST_CGI_LOG(WARN, "failed to parse content length ({})", e.what());
+		if (request->input_buffer) {
+			request->input_buffer->set_max(static_cast<std::size_t>(request->params.content_size()));
 		}
+	} catch (const exception::io_error& e) {
+		FAST_CGI_LOG(INFO, "request {} was cancelled while reading the parameters ({})", request->id, e.what());
+
+		_end_request(request, static_cast<detail::quadruple_type>(-1));
+
+		return;
+	}
+
+	auto encoding = _encoding(*request);
 
-		request->input_buffer->set_max(content_size);
+	// the cache was already searched by the connection thread; the output is captured to store it
+	std::string cache_key;
+	std::unique_ptr<std::string> capture;
+	auto cache = _cache_of(*request, encoding, cache_key);
+
+	if (cache) {
+		capture.reset(new std::string());
 	}
 
+	auto role = factory(&request->arena);
+
 	// initialize input streams
 	io::input_streambuf sin(request->input_buffer);
 	io::input_streambuf sdata(request->data_buffer);
@@ -164,133 +213,553 @@ void request_manager::_request_hanlder(std::unique_ptr<role> role, std::shared_p
 	if (request->role_type == detail::ROLE::FCGI_FILTER || request->role_type == detail::ROLE::FCGI_RESPONDER) {
 		dynamic_cast<responder*>(role.get())->_input_stream = &input_stream;
 
-		// initialize data stream
+		// initialize data stream; both streams are read while they arrive
 		if (request->role_type == detail::ROLE::FCGI_FILTER) {
 			dynamic_cast<filter*>(role.get())->_data_stream = &data_stream;
 
-			std::size_t content_size = 0;
+			request->data_buffer->set_max(static_cast<std::size_t>(request->params.data_size()));
+		}
+	}
 
-			try {
-				content_size = static_cast<std::size_t>(std::stoull(request->params["FCGI_DATA_LENGTH"]));
-			} catch (const std::exception& e) {
-				FAST_CGI_LOG(WARN, "failed to parse data content length ({})", e.what());
-			}
+	// create output streams; the pages grow with every record
+	auto& pages    = request->output_manager->buffer_manager();
+	auto next_page = [&pages, &role](std::size_t& size) -> std::pair<void*, std::size_t> {
+		auto page   = pages.new_page(std::min(std::max(size, role->_initial_page_size), role->_max_page_size));
+		auto usable = memory::buffer_manager::page_size(page);
+
+		size = usable * 2;
+
+		return { page, usable };
+	};
+	std::size_t stdout_size = 0;
+	std::size_t stderr_size = 0;
+	auto governor           = _governor.get();
+	auto throttle_output = [&request, governor] {
+		// wait until the output of this connection was written
+		if (governor) {
+			governor->throttle([&request] {
+				return request->output_manager->pending() == 0 || request->cancellation.cancelled();
+			});
+		}
+	};
+	auto discard_output = [&request] {
+		// the output cannot be written anymore
+		if (request->output_manager->failed()) {
+			request->cancel();
+		}
 
-			request->data_buffer->set_max(content_size);
+		return request->cancellation.cancelled();
+	};
+	auto cache_size     = cache ? cache->max_size() : 0;
+	auto capture_stdout = [&capture, cache_size](const void* buffer, std::size_t size) {
+		if (capture) {
+			capture->append(static_cast<const char*>(buffer), size);
 
-			// wait until input stream finished reading
-			request->input_buffer->wait_for_all_input();
-		} else {
-			request->data_buffer->close();
+			// too large for the cache
+			if (capture->size() > cache_size) {
+				capture.reset();
+			}
 		}
-	} else {
-		request->data_buffer->close();
+	};
+	auto write_stdout = [&request, &capture_stdout, &throttle_output, version](void* buffer, std::size_t size) {
+		capture_stdout(buffer, size);
+
+		// the page is returned when the record was written or discarded
+		detail::stdout_stream stream{ buffer, static_cast<detail::double_type>(size), nullptr,
+			                          memory::buffer_manager::adopt(buffer) };
+
+		request->cancellation.unless_cancelled(
+		    [&] { detail::record::write(version, request->id, *request->output_manager, stream); });
+		throttle_output();
+	};
+	std::unique_ptr<io::compressor> compressor;
+	bool finishing = false;
+
+	if (encoding != io::compressor::encoding::identity) {
+		FAST_CGI_LOG(DEBUG, "compressing output with level {}", _compression_level);
+
+		compressor.reset(new io::compressor(encoding, _compression_level, request->output_manager->buffer_manager(),
+		                                    write_stdout));
 	}
 
-	// create output streams
-	io::output_streambuf sout([&request, version](void* buffer, std::size_t size) -> std::pair<void*, std::size_t> {
-		if (buffer) {
-			auto flag = detail::record::write(version, request->id, *request->output_manager,
-			                                  detail::stdout_stream{ buffer, static_cast<detail::double_type>(size) });
+	// an explicit flush of the role must also pass the compressor
+	auto flush_compressor = [&compressor, &finishing, &discard_output] {
+		if (compressor && !finishing && !discard_output()) {
+			compressor->flush();
+		}
+	};
+	io::output_streambuf sout([&pages, &compressor, &write_stdout, &discard_output, &next_page, &stdout_size,
+	                           &finishing](void* buffer, std::size_t size) -> std::pair<void*, std::size_t> {
+		if (buffer && (!size || discard_output())) {
+			pages.free_page(buffer);
+		} else if (buffer) {
+			// compressed pages are handed to the record writer by the compressor
+			if (compressor) {
+				compressor->write(buffer, size);
+				pages.free_page(buffer);
+			} else {
+				write_stdout(buffer, size);
+			}
+		}
 
-			request->output_manager->buffer_manager().free_page(buffer, flag);
+		// the last page is not replaced
+		return finishing ? std::pair<void*, std::size_t>() : next_page(stdout_size);
+	},
+	                          flush_compressor);
+	// adopted buffers are framed by reference; compressed output is copied by the compressor
+	sout.set_adopter([&request, &compressor, &capture_stdout, &discard_output, &throttle_output](
+	                     const void* data, std::size_t size, std::shared_ptr<const void> owner) {
+		if (discard_output()) {
+			return;
+		} else if (compressor) {
+			compressor->write(data, size);
+
+			return;
 		}
 
-		return { request->output_manager->buffer_manager().new_page(),
-			     request->output_manager->buffer_manager().page_size() };
+		capture_stdout(data, size);
+		_write_owned(*request, data, size, std::move(owner));
+		throttle_output();
 	});
-	io::output_streambuf serr([&request, version](void* buffer, std::size_t size) -> std::pair<void*, std::size_t> {
-		if (buffer) {
-			auto flag = detail::record::write(version, request->id, *request->output_manager,
-			                                  detail::stderr_stream{ buffer, static_cast<detail::double_type>(size) });
-
-			request->output_manager->buffer_manager().free_page(buffer, flag);
+	io::output_streambuf serr([&request, &pages, &throttle_output, &discard_output, &next_page, &stderr_size,
+	                           &finishing, version](void* buffer, std::size_t size) -> std::pair<void*, std::size_t> {
+		if (buffer && (!size || discard_output())) {
+			pages.free_page(buffer);
+		} else if (buffer) {
+			detail::stderr_stream stream{ buffer, static_cast<detail::double_type>(size),
+				                          memory::buffer_manager::adopt(buffer) };
+
+			request->cancellation.unless_cancelled(
+			    [&] { detail::record::write(version, request->id, *request->output_manager, stream); });
+			throttle_output();
 		}
 
-		return { request->output_manager->buffer_manager().new_page(),
-			     request->output_manager->buffer_manager().page_size() };
+		return finishing ? std::pair<void*, std::size_t>() : next_page(stderr_size);
 	});
 	io::byte_ostream output_stream(&sout);
 	io::byte_ostream error_stream(&serr);
 
-	role->_params        = &request->params;
-	role->_output_stream = &output_stream;
-	role->_error_stream  = &error_stream;
-	role->_cancelled     = &request->cancelled;
-
 	// execute the role
-	role::status_code_type status = -1;
+	auto status = _run_role(*role, request->params, request->arena, output_stream, error_stream,
+	                        request->cancellation);
+
+	// finish all output streams and release their last pages; the compressor is finished instead of flushed
+	finishing = true;
+
+	sout.finish();
+
+	if (compressor && !request->cancellation.cancelled()) {
+		try {
+			compressor->finish();
+		} catch (const std::exception& e) {
+			FAST_CGI_LOG(ERROR, "failed to finish compressed output ({})", e.what());
+		}
+	}
+
+	serr.finish();
+
+	// update cache; only decisions of authorizers and cacheable statuses of responders are stored
+	if (cache) {
+		if (capture && status == 0 && !request->cancellation.cancelled() &&
+		    (cache == _authorizer_cache.get() ? response_cache::storable_decision(*capture)
+		                                      : cache->storable(request->params, *capture, _compression_level > 0))) {
+			cache->store(cache_key, std::move(*capture), 0);
+		} else {
+			cache->abandon(cache_key);
+		}
+	}
+
+	// the role lives in the arena
+	role.reset();
+
+	_end_request(request, static_cast<detail::quadruple_type>(status));
+}
+
+void request_manager::_abort(request& request)
+{
+	// the cancellation waits for a record that is being queued; afterwards no record of the request is queued
+	if (request.cancel()) {
+		request.output_manager->discard(request.id);
+	}
+}
+
+void request_manager::_launch(const std::shared_ptr<request>& request)
+{
+	FAST_CGI_LOG(INFO, "launching request thread");
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		++_active;
+	}
+
+	auto factory = _role_factories[request->role_type - 1];
 
+	// launch thread; the role is created there unless the response is cached
+	std::thread([this, factory, request] {
+		_request_hanlder(factory, request);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		--_active;
+		_idle.notify_all();
+	}).detach();
+}
+
+bool request_manager::_deferred(const request& request) const noexcept
+{
+	return !request.params_ready &&
+	       ((_authorizer_cache && request.role_type == detail::ROLE::FCGI_AUTHORIZER) ||
+	        (_response_cache && request.role_type == detail::ROLE::FCGI_RESPONDER));
+}
+
+void request_manager::_lookup(const std::shared_ptr<request>& request)
+{
+	// the stream is closed, so reading does not block
 	try {
-		status = role->run();
-	} catch (const std::exception& e) {
-		FAST_CGI_LOG(ERROR, "role executor threw an exception ({})", e.what());
-	} catch (...) {
-		FAST_CGI_LOG(ERROR, "role executor threw an exception");
+		io::reader reader(request->params_buffer);
+
+		request->params._read_parameters(reader, request->arena, request->params_size);
+	} catch (const exception::io_error& e) {
+		FAST_CGI_LOG(WARN, "failed to read the parameters of request {} ({})", request->id, e.what());
+
+		_end_request(request, static_cast<detail::quadruple_type>(-1));
+
+		return;
 	}
 
-	FAST_CGI_LOG(INFO, "role finished with status code={}", static_cast<detail::quadruple_type>(status));
+	request->params_ready = true;
+
+	std::string key;
+	auto encoding = _encoding(*request);
+	auto cache    = _cache_of(*request, encoding, key);
+
+	if (!cache) {
+		_launch(request);
+
+		return;
+	}
+
+	auto cached = cache->find(key);
+
+	// decisions are not served stale
+	if (cached.first == response_cache::LOOKUP::hit ||
+	    (cache == _response_cache.get() && cached.first != response_cache::LOOKUP::miss)) {
+		FAST_CGI_LOG(DEBUG, "answering request {} from cache", request->id);
+
+		auto status = cached.second->app_status;
+
+		_replay(*request, std::move(cached.second));
+
+		if (cached.first == response_cache::LOOKUP::revalidate) {
+			std::thread(&request_manager::_revalidate, _response_cache, key, _role_factories[request->role_type - 1],
+			            request->params, _allocator, request->output_manager, encoding, _compression_level)
+			    .detach();
+		}
 
-	// flush and finish all output streams
-	output_stream.flush();
-	detail::record::write(version, request->id, *request->output_manager, detail::stdout_stream{ nullptr, 0 });
-	error_stream.flush();
-	detail::record::write(version, request->id, *request->output_manager, detail::stderr_stream{ nullptr, 0 });
+		_end_request(request, status);
+
+		return;
+	} else if (cached.first != response_cache::LOOKUP::miss) {
+		cache->abandon(key);
+	}
+
+	_launch(request);
+}
+
+io::compressor::encoding request_manager::_encoding(const request& request) const
+{
+	auto encoding = io::compressor::encoding::identity;
+
+	// the response to a HEAD request has no body
+	if (_compression_level > 0 && request.role_type != detail::ROLE::FCGI_AUTHORIZER &&
+	    request.params.method() != params::METHOD::HEAD && request.params.has(params::VARIABLE::http_accept_encoding)) {
+		encoding = io::compressor::negotiate(request.params.get(params::VARIABLE::http_accept_encoding));
+	}
+
+	return encoding;
+}
+
+response_cache* request_manager::_cache_of(const request& request, io::compressor::encoding encoding,
+                                           std::string& key) const
+{
+	if (_authorizer_cache && request.role_type == detail::ROLE::FCGI_AUTHORIZER) {
+		key = _authorizer_cache->make_key(request.params);
+
+		return _authorizer_cache.get();
+	} else if (_response_cache && request.role_type == detail::ROLE::FCGI_RESPONDER &&
+	           response_cache::cacheable(request.params)) {
+		// the cached content depends on the encoding
+		key = _response_cache->make_key(request.params);
+		key.push_back('\0');
+		key.push_back(static_cast<char>(encoding));
+
+		return _response_cache.get();
+	}
+
+	return nullptr;
+}
+
+void request_manager::_end_request(const std::shared_ptr<request>& request, detail::quadruple_type status)
+{
+	auto version = detail::VERSION::FCGI_VERSION_1;
+
+	// the rest of the input is skipped; wakes up the connection thread if it waits for the role
+	for (auto buffer : { request->input_buffer.get(), request->data_buffer.get() }) {
+		if (buffer) {
+			buffer->abandon();
+		}
+	}
+
+	detail::record::write(version, request->id, *request->output_manager,
+	                      detail::stdout_stream{ nullptr, 0, nullptr, {} });
+	detail::record::write(version, request->id, *request->output_manager, detail::stderr_stream{ nullptr, 0, {} });
 
 	// end request
 	detail::record::write(version, request->id, *request->output_manager,
-	                      detail::end_request{ static_cast<detail::quadruple_type>(status),
-	                                           detail::PROTOCOL_STATUS::FCGI_REQUEST_COMPLETE });
+	                      detail::end_request{ status, detail::PROTOCOL_STATUS::FCGI_REQUEST_COMPLETE });
 
 	FAST_CGI_LOG(INFO, "request {} finished; removing", request->id);
 
+	// free all request-scoped memory at once
+	request->params._clear();
+	request->arena.reset();
+	request->finished.store(true, std::memory_order_release);
+
+	// the connection must not terminate before the request was removed
+	auto close_connection = request->close_connection;
+
+	_release(request);
+
 	// trigger end and interrupt reading buffer
-	if (request->close_connection) {
+	if (close_connection) {
 		FAST_CGI_LOG(DEBUG, "terminating connection");
 
 		_terminate_connection.store(true, std::memory_order_release);
 		_reader->interrupt();
 	}
+}
 
-	request->finished.store(true, std::memory_order_release);
+void request_manager::_release(const std::shared_ptr<request>& request)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_requests.erase(request->id, request.get())) {
+		_open_requests.store(_requests.size(), std::memory_order_release);
+	}
+
+	if (_pool.size() < max_pool_size) {
+		_pool.push_back(request);
+	}
 }
 
-void request_manager::_begin_request(std::shared_ptr<io::output_manager> output_manager, detail::record record)
+std::shared_ptr<request> request_manager::_acquire()
+{
+	std::shared_ptr<request> request;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		// a request may still be referenced by its handler thread
+		for (auto i = _pool.begin(); i != _pool.end(); ++i) {
+			if (i->use_count() == 1) {
+				request = std::move(*i);
+				_pool.erase(i);
+
+				break;
+			}
+		}
+	}
+
+	if (!request) {
+		return std::make_shared<struct request>(_params_allocator, _input_allocator);
+	}
+
+	// pairs with the release of the last reference by the handler thread
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	return request;
+}
+
+void request_manager::_replay(request& request, std::shared_ptr<const response_cache::entry> entry)
+{
+	auto& content = entry->content;
+
+	_write_owned(request, content.data(), content.size(), std::move(entry));
+}
+
+void request_manager::_write_owned(request& request, const void* data, std::size_t size,
+                                   std::shared_ptr<const void> owner)
+{
+	auto content = static_cast<const char*>(data);
+
+	// an abort discards the queued records; no record may be queued after it
+	request.cancellation.unless_cancelled([&] {
+		for (std::size_t offset = 0; offset < size;) {
+			auto length = std::min<std::size_t>(size - offset, std::numeric_limits<detail::double_type>::max());
+
+			detail::record::write(
+			    detail::VERSION::FCGI_VERSION_1, request.id, *request.output_manager,
+			    detail::stdout_stream{ content + offset, static_cast<detail::double_type>(length), owner, {} });
+
+			offset += length;
+		}
+	});
+}
+
+role::status_code_type request_manager::_run_role(role& role, class params& params, memory::arena& arena,
+                                                  io::byte_ostream& output, io::byte_ostream& error,
+                                                  cancellation& cancellation)
 {
-	auto body    = detail::begin_request::read(*_reader);
-	auto request = std::make_shared<struct request>(record.request_id, body.role, std::move(output_manager),
-	                                                (body.flags & detail::FLAGS::FCGI_KEEP_CONN) == 0, _allocator);
+	role._params        = &params;
+	role._arena         = &arena;
+	role._output_stream = &output;
+	role._output_buffer = static_cast<io::output_streambuf*>(output.rdbuf());
+	role._error_stream  = &error;
+	role._cancelled     = &cancellation;
 
-	switch (body.role) {
-	case detail::ROLE::FCGI_AUTHORIZER:
-	case detail::ROLE::FCGI_FILTER:
-	case detail::ROLE::FCGI_RESPONDER: {
-		auto& factory = _role_factories[body.role - 1];
+	role._output_buffer->set_flush_on_sync(role._flush_on_sync);
+
+	role::status_code_type status = -1;
+
+	try {
+		status = role.run();
+	} catch (const std::exception& e) {
+		FAST_CGI_LOG(ERROR, "role executor threw an exception ({})", e.what());
+	} catch (...) {
+		FAST_CGI_LOG(ERROR, "role executor threw an exception");
+	}
 
-		if (factory) {
-			auto role = factory();
+	// the callback may refer to the role
+	cancellation.set_callback(nullptr);
 
-			FAST_CGI_LOG(INFO, "created role; launching request thread");
+	FAST_CGI_LOG(INFO, "role finished with status code={}", static_cast<detail::quadruple_type>(status));
 
-			// launch thread
-			request->handler_thread = std::thread(&request_manager::_request_hanlder, this, std::move(role), request);
+	return status;
+}
 
-			break;
-		} // else fall through, because role is unimplemented
+void request_manager::_revalidate(std::shared_ptr<response_cache> cache, std::string key, role_factory_type factory,
+                                  class params params, std::shared_ptr<memory::allocator> allocator,
+                                  std::shared_ptr<io::output_manager> output_manager,
+                                  io::compressor::encoding encoding, int compression_level)
+{
+	FAST_CGI_LOG(DEBUG, "revalidating cached response");
+
+	// the output is only captured for the cache
+	std::string content;
+	auto& pages = output_manager->buffer_manager();
+	auto write_stdout = [&content, &pages](void* buffer, std::size_t size) {
+		content.append(static_cast<const char*>(buffer), size);
+		pages.free_page(buffer);
+	};
+	std::unique_ptr<io::compressor> compressor;
+
+	if (encoding != io::compressor::encoding::identity) {
+		compressor.reset(new io::compressor(encoding, compression_level, pages, write_stdout));
 	}
-	default: {
+
+	io::output_streambuf sout(
+	    [&compressor, &pages, &write_stdout](void* buffer, std::size_t size) -> std::pair<void*, std::size_t> {
+		    if (buffer) {
+			    if (compressor) {
+				    compressor->write(buffer, size);
+				    pages.free_page(buffer);
+			    } else {
+				    write_stdout(buffer, size);
+			    }
+		    }
+
+		    return { pages.new_page(), pages.page_size() };
+	    });
+	io::output_streambuf serr([&pages](void* buffer, std::size_t /* size */) -> std::pair<void*, std::size_t> {
+		if (buffer) {
+			pages.free_page(buffer);
+		}
+
+		return { pages.new_page(), pages.page_size() };
+	});
+	io::input_streambuf sin(std::make_shared<memory::buffer>(allocator, 0));
+	io::byte_ostream output_stream(&sout);
+	io::byte_ostream error_stream(&serr);
+	io::byte_istream input_stream(&sin);
+	class cancellation cancellation;
+	memory::arena arena(allocator);
+	role::status_code_type status = -1;
+
+	try {
+		auto role = factory(&arena);
+
+		dynamic_cast<responder&>(*role)._input_stream = &input_stream;
+
+		status = _run_role(*role, params, arena, output_stream, error_stream, cancellation);
+
+		sout.flush();
+
+		if (compressor) {
+			compressor->finish();
+		}
+	} catch (const std::exception& e) {
+		FAST_CGI_LOG(ERROR, "failed to revalidate cached response ({})", e.what());
+
+		status = -1;
+	}
+
+	if (status == 0 && cache->storable(params, content, compression_level > 0)) {
+		cache->store(key, std::move(content), 0);
+	} else {
+		cache->abandon(key);
+	}
+}
+
+void request_manager::_begin_request(std::shared_ptr<io::output_manager> output_manager, detail::record record)
+{
+	auto body = detail::begin_request::read(*_reader);
+
+	// reject while the memory limit is exceeded
+	if (_governor && _governor->under_pressure()) {
+		FAST_CGI_LOG(WARN, "rejecting request {} because the memory limit is exceeded", record.request_id);
+
+		_governor->refuse();
+
+		detail::record::write(detail::FCGI_VERSION_1, record.request_id, *output_manager,
+		                      detail::end_request{ 0, detail::PROTOCOL_STATUS::FCGI_OVERLOADED });
+
+		return;
+	}
+
+	auto request = _acquire();
+
+	request->reset(record.request_id, body.role, std::move(output_manager),
+	               (body.flags & detail::FLAGS::FCGI_KEEP_CONN) == 0);
+
+	auto implemented = (body.role == detail::ROLE::FCGI_AUTHORIZER || body.role == detail::ROLE::FCGI_FILTER ||
+	                    body.role == detail::ROLE::FCGI_RESPONDER) &&
+	                   _role_factories[body.role - 1];
+
+	// reject because role is unknown or unimplemented
+	if (!implemented) {
 		FAST_CGI_LOG(ERROR, "begin request record rejected because of unknown/unimplemented role {}", body.role);
 
-		// reject because role is unknown
 		detail::record::write(detail::FCGI_VERSION_1, record.request_id, *request->output_manager,
 		                      detail::end_request{ 0, detail::PROTOCOL_STATUS::FCGI_UNKNOWN_ROLE });
 
+		_release(request);
+
 		return;
 	}
+
+	// add request before the thread can remove it
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_requests.insert(record.request_id, request);
+		_open_requests.store(_requests.size(), std::memory_order_release);
 	}
 
-	// add request
-	_requests.insert({ record.request_id, std::move(request) });
+	// wait for the parameters to look up the decision
+	if (!_deferred(*request)) {
+		_launch(request);
+	}
 }
 
 } // namespace detail
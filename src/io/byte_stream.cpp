@@ -31,16 +31,128 @@ input_streambuf::int_type input_streambuf::underflow()
 	return traits_type::to_int_type(*ptr);
 }
 
-output_streambuf::output_streambuf(writer_type writer) : _writer(writer)
+std::pair<const byte_type*, std::size_t> input_streambuf::read_chunk()
+{
+	if (gptr() == egptr() && traits_type::eq_int_type(underflow(), traits_type::eof())) {
+		return { nullptr, 0 };
+	}
+
+	std::pair<const byte_type*, std::size_t> chunk(gptr(), static_cast<std::size_t>(egptr() - gptr()));
+
+	setg(eback(), egptr(), egptr());
+
+	return chunk;
+}
+
+output_streambuf::output_streambuf(writer_type writer, flusher_type flusher)
+    : _writer(std::move(writer)), _flusher(std::move(flusher)), _flush_on_sync(false)
 {}
 
+void output_streambuf::flush()
+{
+	if (pptr() > pbase()) {
+		_next_page();
+	}
+
+	if (_flusher) {
+		_flusher();
+	}
+}
+
+void output_streambuf::finish()
+{
+	if (pbase()) {
+		auto next = _writer(pbase(), static_cast<std::size_t>(pptr() - pbase()));
+
+		setp(static_cast<byte_type*>(next.first), static_cast<byte_type*>(next.first) + next.second);
+	}
+}
+
+void output_streambuf::set_flush_on_sync(bool enable) noexcept
+{
+	_flush_on_sync = enable;
+}
+
+byte_type* output_streambuf::reserve(std::size_t size)
+{
+	while (!pptr() || static_cast<std::size_t>(epptr() - pptr()) < size) {
+		auto empty    = pptr() == pbase();
+		auto capacity = epptr() - pbase();
+		auto next     = _writer(pbase(), static_cast<std::size_t>(pptr() - pbase()));
+
+		setp(static_cast<byte_type*>(next.first), static_cast<byte_type*>(next.first) + next.second);
+
+		// an empty page was exchanged for one that is not larger
+		if (!pptr() || (empty && epptr() - pbase() <= capacity)) {
+			break;
+		}
+	}
+
+	return pptr() && static_cast<std::size_t>(epptr() - pptr()) >= size ? pptr() : nullptr;
+}
+
+void output_streambuf::commit(std::size_t size) noexcept
+{
+	pbump(static_cast<int>(size));
+}
+
+std::size_t output_streambuf::write(const const_buffer* buffers, std::size_t count)
+{
+	std::size_t written = 0;
+
+	for (auto end = buffers + count; buffers != end; ++buffers) {
+		auto size = static_cast<std::streamsize>(buffers->size);
+		auto s    = xsputn(static_cast<const char_type*>(buffers->data), size);
+
+		written += static_cast<std::size_t>(s);
+
+		if (s != size) {
+			break;
+		}
+	}
+
+	return written;
+}
+
+std::size_t output_streambuf::write(std::initializer_list<const_buffer> buffers)
+{
+	return write(buffers.begin(), buffers.size());
+}
+
+void output_streambuf::set_adopter(adopter_type adopter)
+{
+	_adopter = std::move(adopter);
+}
+
+void output_streambuf::adopt(const void* data, std::size_t size, std::shared_ptr<const void> owner)
+{
+	if (!size) {
+		return;
+	} else if (!_adopter) {
+		write({ { data, size } });
+
+		return;
+	}
+
+	if (pptr() > pbase()) {
+		_next_page();
+	}
+
+	_adopter(data, size, std::move(owner));
+}
+
+void output_streambuf::adopt(std::string&& content)
+{
+	adopt(std::make_shared<std::string>(std::move(content)));
+}
+
 std::streamsize output_streambuf::xsputn(const char_type* s, std::streamsize count)
 {
 	const auto initial_count = count;
 
 	while (count) {
 		if (epptr() == pptr()) {
-			sync();
+			_next_page();
 
 			if (epptr() == pptr()) {
 				break;
@@ -61,10 +173,9 @@ std::streamsize output_streambuf::xsputn(const char_type* s, std::streamsize cou
 
 int output_streambuf::sync()
 {
-	if (!pptr() || pptr() > pbase()) {
-		auto _buffer = _writer(pbase(), static_cast<std::size_t>(pptr() - pbase()));
-
-		setp(static_cast<byte_type*>(_buffer.first), static_cast<byte_type*>(_buffer.first) + _buffer.second);
+	// the page is handed out when it is full
+	if (_flush_on_sync) {
+		flush();
 	}
 
 	return 0;
@@ -73,7 +184,7 @@ int output_streambuf::sync()
 output_streambuf::int_type output_streambuf::overflow(int_type c)
 {
 	// write
-	sync();
+	_next_page();
 
 	// buffer is full
 	if (pptr() == epptr()) {
@@ -85,5 +196,14 @@ output_streambuf::int_type output_streambuf::overflow(int_type c)
 	return traits_type::to_int_type(0);
 }
 
+void output_streambuf::_next_page()
+{
+	if (!pptr() || pptr() > pbase()) {
+		auto _buffer = _writer(pbase(), static_cast<std::size_t>(pptr() - pbase()));
+
+		setp(static_cast<byte_type*>(_buffer.first), static_cast<byte_type*>(_buffer.first) + _buffer.second);
+	}
+}
+
 } // namespace io
 } // namespace fast_cgi
\ No newline at end of file
@@ -0,0 +1,376 @@
+#if defined(FAST_CGI_ENABLE_COMPRESSION)
+
+#	include "fast_cgi/exception/io_error.hpp"
+#	include "fast_cgi/io/compressor.hpp"
+#	include "fast_cgi/log.hpp"
+
+#	include <algorithm>
+#	include <cctype>
+#	include <cstdint>
+#	include <cstdlib>
+#	include <cstring>
+#	include <zlib.h>
+
+namespace fast_cgi {
+namespace io {
+
+namespace {
+
+/** the header block is passed through unchanged if it exceeds this size */
+constexpr std::size_t max_header_size = 16384;
+
+bool starts_with_ignore_case(const std::string& string, std::size_t offset, const char* prefix)
+{
+	for (; *prefix; ++prefix, ++offset) {
+		if (offset >= string.size() || std::tolower(static_cast<unsigned char>(string[offset])) !=
+		                                   std::tolower(static_cast<unsigned char>(*prefix))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/** checks whether the header line sets a status that forbids a body */
+bool bodyless_status(const std::string& string, std::size_t offset)
+{
+	if (!starts_with_ignore_case(string, offset, "status:")) {
+		return false;
+	}
+
+	offset += 7;
+
+	while (offset < string.size() && (string[offset] == ' ' || string[offset] == '\t')) {
+		++offset;
+	}
+
+	return string.compare(offset, 3, "204") == 0 || string.compare(offset, 3, "304") == 0 ||
+	       (offset < string.size() && string[offset] == '1');
+}
+
+} // namespace
+
+struct compressor::stream
+{
+	z_stream z;
+};
+
+compressor::encoding compressor::negotiate(const std::string& accept_encoding)
+{
+	auto gzip     = false;
+	auto deflate  = false;
+	auto wildcard = false;
+	auto refused  = false;
+
+	for (std::size_t begin = 0; begin < accept_encoding.size();) {
+		auto end = std::min(accept_encoding.find(',', begin), accept_encoding.size());
+		auto sep = std::min(accept_encoding.find(';', begin), end);
+
+		// trim coding
+		auto first = begin;
+		auto last  = sep;
+
+		while (first < last && std::isspace(static_cast<unsigned char>(accept_encoding[first]))) {
+			++first;
+		}
+
+		while (last > first && std::isspace(static_cast<unsigned char>(accept_encoding[last - 1]))) {
+			--last;
+		}
+
+		// a quality of zero refuses the coding
+		auto quality = 1.0;
+		auto q       = accept_encoding.find("q=", sep);
+
+		if (q < end) {
+			quality = std::strtod(accept_encoding.c_str() + q + 2, nullptr);
+		}
+
+		auto coding = accept_encoding.substr(first, last - first);
+
+		std::transform(coding.begin(), coding.end(), coding.begin(),
+		               [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+		if (coding == "gzip" || coding == "x-gzip") {
+			gzip    = quality > 0;
+			refused = refused || quality <= 0;
+		} else if (coding == "deflate") {
+			deflate = quality > 0;
+		} else if (coding == "*") {
+			wildcard = quality > 0;
+		}
+
+		begin = end + 1;
+	}
+
+	if (gzip || (wildcard && !refused)) {
+		return encoding::gzip;
+	} else if (deflate) {
+		return encoding::deflate;
+	}
+
+	return encoding::identity;
+}
+
+compressor::compressor(encoding content_encoding, int level, memory::buffer_manager& buffer_manager, sink_type sink)
+    : _state(STATE::header), _encoding(content_encoding), _stream(new stream{}), _buffer_manager(buffer_manager),
+      _sink(std::move(sink))
+{
+	_page          = nullptr;
+	_page_used     = 0;
+	_page_capacity = 0;
+
+	// window bits of 15 + 16 produce a gzip wrapper
+	auto window_bits = content_encoding == encoding::gzip ? 15 + 16 : 15;
+
+	if (deflateInit2(&_stream->z, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		throw exception::io_error("failed to initialize deflate stream");
+	}
+}
+
+compressor::~compressor()
+{
+	deflateEnd(&_stream->z);
+
+	if (_page) {
+		_buffer_manager.free_page(_page);
+	}
+}
+
+void compressor::write(const void* data, std::size_t size)
+{
+	switch (_state) {
+	case STATE::header: _write_header(data, size); break;
+	case STATE::pending:
+		if (size) {
+			_begin_body();
+			_deflate(data, size, Z_NO_FLUSH);
+		}
+
+		break;
+	case STATE::body: _deflate(data, size, Z_NO_FLUSH); break;
+	case STATE::passthrough: _write_raw(data, size); break;
+	default: break;
+	}
+}
+
+void compressor::flush()
+{
+	if (_state == STATE::header || _state == STATE::pending) {
+		return;
+	} else if (_state == STATE::body) {
+		_deflate(nullptr, 0, Z_SYNC_FLUSH);
+	}
+
+	if (_page && _page_used) {
+		_sink(_page, _page_used);
+
+		_page      = nullptr;
+		_page_used = 0;
+	}
+}
+
+void compressor::finish()
+{
+	// no complete header or no body was written -> nothing to compress
+	if (_state == STATE::header || _state == STATE::pending) {
+		_write_raw(_header.data(), _header.size());
+		_header.clear();
+
+		_state = STATE::passthrough;
+	}
+
+	if (_state == STATE::body) {
+		_deflate(nullptr, 0, Z_FINISH);
+	}
+
+	if (_page && _page_used) {
+		_sink(_page, _page_used);
+
+		_page      = nullptr;
+		_page_used = 0;
+	}
+
+	_state = STATE::finished;
+}
+
+void compressor::_write_header(const void* data, std::size_t size)
+{
+	// only search the new part for the end of the header block
+	auto offset = _header.size() < 3 ? 0 : _header.size() - 3;
+
+	_header.append(static_cast<const char*>(data), size);
+
+	auto crlf = _header.find("\r\n\r\n", offset);
+	auto lf   = _header.find("\n\n", offset);
+
+	if (crlf == std::string::npos && lf == std::string::npos) {
+		if (_header.size() > max_header_size) {
+			FAST_CGI_LOG(WARN, "header block too large; disabling compression");
+
+			_state = STATE::passthrough;
+
+			_write_raw(_header.data(), _header.size());
+			_header.clear();
+		}
+
+		return;
+	}
+
+	// the header block ends after the blank line
+	auto end = crlf < lf ? crlf + 4 : lf + 2;
+
+	// responses that are already encoded or must not have a body are passed through
+	for (std::size_t line = 0; line < end;) {
+		if (starts_with_ignore_case(_header, line, "content-encoding:") || bodyless_status(_header, line)) {
+			_state = STATE::passthrough;
+
+			_write_raw(_header.data(), _header.size());
+			_header.clear();
+
+			return;
+		}
+
+		line = _header.find('\n', line) + 1;
+	}
+
+	// the header block is only rewritten when the body is not empty
+	auto body = _header.substr(end);
+
+	_header.resize(end);
+
+	_state = STATE::pending;
+
+	write(body.data(), body.size());
+}
+
+void compressor::_begin_body()
+{
+	auto blank = _header.size() >= 2 && _header[_header.size() - 2] == '\r' ? 2 : 1;
+	auto end   = _header.size() - blank;
+
+	// the length of the compressed content is unknown
+	for (std::size_t line = 0; line < end;) {
+		auto next = _header.find('\n', line) + 1;
+
+		if (!starts_with_ignore_case(_header, line, "content-length:")) {
+			_write_raw(_header.data() + line, next - line);
+		}
+
+		line = next;
+	}
+
+	const char* value = _encoding == encoding::gzip ? "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n"
+	                                                : "Content-Encoding: deflate\r\nVary: Accept-Encoding\r\n";
+
+	_write_raw(value, std::strlen(value));
+	_write_raw(_header.data() + end, blank);
+
+	std::string().swap(_header);
+
+	_state = STATE::body;
+}
+
+void compressor::_write_raw(const void* data, std::size_t size)
+{
+	auto ptr = static_cast<const std::uint8_t*>(data);
+
+	while (size) {
+		if (!_page || _page_used == _page_capacity) {
+			_next_page();
+		}
+
+		auto s = std::min(size, _page_capacity - _page_used);
+
+		std::memcpy(static_cast<std::uint8_t*>(_page) + _page_used, ptr, s);
+
+		_page_used += s;
+		ptr += s;
+		size -= s;
+	}
+}
+
+void compressor::_deflate(const void* data, std::size_t size, int flush)
+{
+	auto& z = _stream->z;
+
+	z.next_in  = static_cast<Bytef*>(const_cast<void*>(data));
+	z.avail_in = static_cast<uInt>(size);
+
+	while (true) {
+		if (!_page || _page_used == _page_capacity) {
+			_next_page();
+		}
+
+		auto available = _page_capacity - _page_used;
+
+		z.next_out  = static_cast<Bytef*>(_page) + _page_used;
+		z.avail_out = static_cast<uInt>(available);
+
+		auto result = deflate(&z, flush);
+
+		if (result == Z_STREAM_ERROR) {
+			throw exception::io_error("failed to deflate output");
+		}
+
+		_page_used += available - z.avail_out;
+
+		// deflate is done when it did not fill the whole page
+		if (z.avail_out != 0 || result == Z_STREAM_END) {
+			break;
+		}
+	}
+}
+
+void compressor::_next_page()
+{
+	if (_page) {
+		_sink(_page, _page_used);
+	}
+
+	_page          = _buffer_manager.new_page(_page_capacity * 2);
+	_page_used     = 0;
+	_page_capacity = memory::buffer_manager::page_size(_page);
+}
+
+} // namespace io
+} // namespace fast_cgi
+
+#else
+
+#	include "fast_cgi/exception/io_error.hpp"
+#	include "fast_cgi/io/compressor.hpp"
+
+namespace fast_cgi {
+namespace io {
+
+struct compressor::stream
+{};
+
+compressor::encoding compressor::negotiate(const std::string& /* accept_encoding */)
+{
+	return encoding::identity;
+}
+
+compressor::compressor(encoding content_encoding, int /* level */, memory::buffer_manager& buffer_manager,
+                       sink_type sink)
+    : _state(STATE::finished), _encoding(content_encoding), _buffer_manager(buffer_manager), _sink(std::move(sink))
+{
+	throw exception::io_error("compression is not supported");
+}
+
+compressor::~compressor() = default;
+
+void compressor::write(const void* /* data */, std::size_t /* size */)
+{}
+
+void compressor::flush()
+{}
+
+void compressor::finish()
+{}
+
+} // namespace io
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
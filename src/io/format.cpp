@@ -0,0 +1,165 @@
+#include "fast_cgi/exception/format_error.hpp"
+#include "fast_cgi/io/format.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace fast_cgi {
+namespace io {
+
+namespace {
+
+constexpr char digit_pairs[] = "00010203040506070809"
+                               "10111213141516171819"
+                               "20212223242526272829"
+                               "30313233343536373839"
+                               "40414243444546474849"
+                               "50515253545556575859"
+                               "60616263646566676869"
+                               "70717273747576777879"
+                               "80818283848586878889"
+                               "90919293949596979899";
+
+std::size_t count_digits(unsigned long long value) noexcept
+{
+	std::size_t count = 1;
+
+	while (true) {
+		if (value < 10) {
+			return count;
+		} else if (value < 100) {
+			return count + 1;
+		} else if (value < 1000) {
+			return count + 2;
+		} else if (value < 10000) {
+			return count + 3;
+		}
+
+		value /= 10000;
+		count += 4;
+	}
+}
+
+void write(output_streambuf& buffer, const void* data, std::size_t size)
+{
+	const_buffer b{ data, size };
+
+	buffer.write(&b, 1);
+}
+
+template<typename T>
+void write_number(output_streambuf& buffer, T value)
+{
+	// format directly into the page
+	if (auto ptr = buffer.reserve(max_number_size)) {
+		buffer.commit(format_number(ptr, value));
+	} else {
+		char tmp[max_number_size];
+
+		write(buffer, tmp, format_number(tmp, value));
+	}
+}
+
+} // namespace
+
+std::size_t format_number(char* output, long long value) noexcept
+{
+	if (value < 0) {
+		*output = '-';
+
+		// negate without overflowing
+		return format_number(output + 1, 0ull - static_cast<unsigned long long>(value)) + 1;
+	}
+
+	return format_number(output, static_cast<unsigned long long>(value));
+}
+
+std::size_t format_number(char* output, unsigned long long value) noexcept
+{
+	auto size = count_digits(value);
+	auto ptr  = output + size;
+
+	// two digits at once
+	while (value >= 100) {
+		auto index = static_cast<std::size_t>(value % 100) * 2;
+
+		value /= 100;
+		*--ptr = digit_pairs[index + 1];
+		*--ptr = digit_pairs[index];
+	}
+
+	if (value >= 10) {
+		auto index = static_cast<std::size_t>(value) * 2;
+
+		*--ptr = digit_pairs[index + 1];
+		*--ptr = digit_pairs[index];
+	} else {
+		*--ptr = static_cast<char>('0' + value);
+	}
+
+	return size;
+}
+
+std::size_t format_number(char* output, double value) noexcept
+{
+	// integral values below 10^6 print like integers with the default precision of 6
+	if (std::abs(value) < 1e6 && value == std::trunc(value) && !(value == 0 && std::signbit(value))) {
+		return format_number(output, static_cast<long long>(value));
+	}
+
+	// the default C locale does not change the decimal point
+	auto size = std::snprintf(output, max_number_size, "%g", value);
+
+	return size < 0 ? 0 : static_cast<std::size_t>(size);
+}
+
+void vformat(output_streambuf& buffer, const char* format, const format_argument* arguments, std::size_t count)
+{
+	auto end = arguments + count;
+
+	while (*format) {
+		// find next brace
+		auto ptr = format;
+
+		while (*ptr && *ptr != '{' && *ptr != '}') {
+			++ptr;
+		}
+
+		if (ptr != format) {
+			write(buffer, format, static_cast<std::size_t>(ptr - format));
+		}
+
+		if (!*ptr) {
+			break;
+		}
+
+		// escaped braces
+		if (ptr[1] == ptr[0]) {
+			write(buffer, ptr, 1);
+
+			format = ptr + 2;
+
+			continue;
+		} else if (ptr[0] == '}' || ptr[1] != '}') {
+			throw exception::format_error("invalid brace in format string");
+		} else if (arguments == end) {
+			throw exception::format_error("too few format arguments");
+		}
+
+		switch (arguments->type) {
+		case format_argument::TYPE::signed_integer: write_number(buffer, arguments->signed_integer); break;
+		case format_argument::TYPE::unsigned_integer: write_number(buffer, arguments->unsigned_integer); break;
+		case format_argument::TYPE::floating: write_number(buffer, arguments->floating); break;
+		case format_argument::TYPE::character: write(buffer, &arguments->character, 1); break;
+		case format_argument::TYPE::string: write(buffer, arguments->string.data, arguments->string.size); break;
+		default: break;
+		}
+
+		++arguments;
+		format = ptr + 2;
+	}
+}
+
+} // namespace io
+} // namespace fast_cgi
\ No newline at end of file
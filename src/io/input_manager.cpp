@@ -4,15 +4,19 @@
 #include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <limits>
 #include <thread>
 
 namespace fast_cgi {
 namespace io {
 
 std::shared_ptr<reader> input_manager::launch_input_manager(std::shared_ptr<connection> connection,
-                                                            std::shared_ptr<memory::allocator> allocator)
+                                                            std::shared_ptr<memory::allocator> allocator,
+                                                            std::shared_ptr<memory::governor> governor,
+                                                            std::size_t capacity)
 {
-	std::shared_ptr<input_manager> im(new input_manager(std::move(connection), std::move(allocator)));
+	std::shared_ptr<input_manager> im(
+	    new input_manager(std::move(connection), std::move(allocator), std::move(governor), capacity));
 	auto r = std::make_shared<reader>(im->_buffer);
 
 	// launch reader
@@ -21,20 +25,44 @@ std::shared_ptr<reader> input_manager::launch_input_manager(std::shared_ptr<conn
 	return r;
 }
 
-input_manager::input_manager(std::shared_ptr<connection> connection, std::shared_ptr<memory::allocator> allocator)
-    : _buffer(new memory::buffer(std::move(allocator), 999999)), _connection(std::move(connection))
-{}
+input_manager::input_manager(std::shared_ptr<connection> connection, std::shared_ptr<memory::allocator> allocator,
+                             std::shared_ptr<memory::governor> governor, std::size_t capacity)
+    : _buffer(new memory::buffer(std::move(allocator), std::numeric_limits<std::size_t>::max())),
+      _connection(std::move(connection)), _governor(std::move(governor))
+{
+	_buffer->set_capacity(capacity);
+}
 
 void input_manager::_run(std::shared_ptr<input_manager> self)
 {
 	std::uint8_t buffer[1024];
 
 	while (true) {
+		// stop reading while the connection thread lags behind
+		if (!self->_buffer->wait_for_space()) {
+			FAST_CGI_LOG(INFO, "buffer was interrupted; exiting input thread");
+
+			return;
+		}
+
+		// stop reading until the buffered input was processed
+		if (self->_governor) {
+			auto& buffer = *self->_buffer;
+
+			self->_governor->throttle([&buffer] { return buffer.size() == 0 || buffer.interrupted(); });
+		}
+
 		// spin
 		while (!self->_connection->in_available()) {
 			if (self->_buffer->interrupted()) {
 				FAST_CGI_LOG(INFO, "buffer was interrupted; exiting input thread");
 
+				return;
+			} else if (self->_connection->closed()) {
+				FAST_CGI_LOG(INFO, "connection was closed by the peer; exiting input thread");
+
+				self->_buffer->close();
+
 				return;
 			}
 
@@ -63,6 +91,9 @@ void input_manager::_run(std::shared_ptr<input_manager> self)
 			ptr += buf.second;
 		}
 	}
+
+	// let the reader reach the end
+	self->_buffer->close();
 }
 
 } // namespace io
@@ -5,7 +5,7 @@ namespace fast_cgi {
 namespace io {
 
 output_manager::output_manager(std::shared_ptr<connection> connection, std::shared_ptr<memory::allocator> allocator)
-    : _alive(true), _writer(std::move(connection)), _thread(&output_manager::_run, this),
+    : _alive(true), _failed(false), _writer(std::move(connection)), _thread(&output_manager::_run, this),
       _buffer_manager(1024, std::move(allocator))
 {
 	FAST_CGI_LOG(TRACE, "output manager thread started");
@@ -29,30 +29,71 @@ memory::buffer_manager& output_manager::buffer_manager() noexcept
 	return _buffer_manager;
 }
 
-std::shared_ptr<std::atomic_bool> output_manager::add(task_type task)
+void output_manager::add(task_type task, detail::double_type request_id)
 {
 	FAST_CGI_LOG(DEBUG, "adding output task");
 
 	std::lock_guard<std::mutex> lock(_mutex);
-	std::shared_ptr<std::atomic_bool> ret(new std::atomic_bool(false));
 
-	_queue.push_back({ std::move(task), ret });
+	// nobody receives the output
+	if (_failed.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	_queue.emplace_back(request_id, std::move(task));
 	_cv.notify_one();
+}
+
+std::size_t output_manager::discard(detail::double_type request_id)
+{
+	std::deque<queue_type> discarded;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		std::deque<queue_type> kept;
+
+		for (auto& task : _queue) {
+			(task.first == request_id ? discarded : kept).push_back(std::move(task));
+		}
+
+		_queue.swap(kept);
+	}
+
+	FAST_CGI_LOG(DEBUG, "discarded {} output task(s) of request {}", discarded.size(), request_id);
+
+	// the tasks are destroyed without holding the lock
+	return discarded.size();
+}
+
+std::size_t output_manager::pending()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
 
-	return ret;
+	return _queue.size();
+}
+
+bool output_manager::failed() const noexcept
+{
+	return _failed.load(std::memory_order_acquire);
 }
 
 void output_manager::_run()
 {
 	while (true) {
-		queue_type task;
+		task_type task;
 
 		// poll queue
 		{
 			std::unique_lock<std::mutex> lock(_mutex);
 
-			if (_queue.empty()) {
-				_writer.flush();
+			if (_queue.empty() && !_failed.load(std::memory_order_relaxed)) {
+				try {
+					_writer.flush();
+				} catch (const std::exception& e) {
+					FAST_CGI_LOG(CRITICAL, "failed to flush the connection ({})", e.what());
+
+					_failed.store(true, std::memory_order_release);
+				}
 			}
 
 			_cv.wait(lock, [&] { return !_queue.empty() || !_alive; });
@@ -61,7 +102,7 @@ void output_manager::_run()
 				break;
 			}
 
-			task = std::move(_queue.front());
+			task = std::move(_queue.front().second);
 			_queue.pop_front();
 		}
 
@@ -69,15 +110,31 @@ void output_manager::_run()
 
 		// execute task
 		try {
-			task.first(_writer);
+			task(_writer);
 		} catch (const std::exception& e) {
 			FAST_CGI_LOG(CRITICAL, "failed to execute writer task ({})", e.what());
+
+			_fail();
 		} catch (...) {
 			FAST_CGI_LOG(CRITICAL, "failed to execute writer task");
+
+			_fail();
 		}
+	}
+}
 
-		task.second->store(true, std::memory_order_release);
+void output_manager::_fail()
+{
+	std::deque<queue_type> dropped;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_failed.store(true, std::memory_order_release);
+		_queue.swap(dropped);
 	}
+
+	FAST_CGI_LOG(WARN, "connection failed; dropping {} output task(s)", dropped.size());
 }
 
 } // namespace io
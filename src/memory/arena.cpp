@@ -0,0 +1,124 @@
+#include "fast_cgi/memory/arena.hpp"
+
+#include <algorithm>
+
+namespace fast_cgi {
+namespace memory {
+
+namespace {
+
+constexpr std::size_t chunk_alignment = alignof(std::max_align_t);
+
+std::uint8_t* align_up(std::uint8_t* ptr, std::size_t align) noexcept
+{
+	return reinterpret_cast<std::uint8_t*>((reinterpret_cast<std::uintptr_t>(ptr) + align - 1) & ~(align - 1));
+}
+
+} // namespace
+
+arena::arena(std::shared_ptr<allocator> allocator, std::size_t chunk_size, std::size_t max_retained_size)
+    : _allocator(std::move(allocator))
+{
+	_chunk_size        = chunk_size;
+	_max_retained_size = max_retained_size;
+	_chunks            = nullptr;
+	_capacity          = 0;
+	_begin             = nullptr;
+	_end               = nullptr;
+}
+
+arena::~arena()
+{
+	release();
+}
+
+void* arena::allocate(std::size_t size, std::size_t align)
+{
+	auto ptr = _begin ? align_up(_begin, align) : nullptr;
+
+	// new chunk required
+	if (!ptr || ptr + size > _end) {
+		auto header = (sizeof(chunk) + chunk_alignment - 1) / chunk_alignment * chunk_alignment;
+		auto total  = std::max(_chunk_size, header + size + align);
+		auto c      = static_cast<chunk*>(_allocator->allocate(total, chunk_alignment));
+
+		c->next = _chunks;
+		c->size = total;
+		_chunks = c;
+		_capacity += total;
+
+		_begin = reinterpret_cast<std::uint8_t*>(c) + header;
+		_end   = reinterpret_cast<std::uint8_t*>(c) + total;
+		ptr    = align_up(_begin, align);
+	}
+
+	_begin = ptr + size;
+
+	return ptr;
+}
+
+void arena::deallocate(void* /* ptr */, std::size_t /* size */)
+{}
+
+void arena::reset() noexcept
+{
+	if (!_chunks) {
+		return;
+	}
+
+	// keep the largest chunk that is not too large
+	chunk* largest = nullptr;
+
+	for (auto c = _chunks; c; c = c->next) {
+		if (c->size <= _max_retained_size && (!largest || c->size > largest->size)) {
+			largest = c;
+		}
+	}
+
+	if (!largest) {
+		release();
+
+		return;
+	}
+
+	for (auto c = _chunks; c;) {
+		auto next = c->next;
+
+		if (c != largest) {
+			_capacity -= c->size;
+			_allocator->deallocate(c, c->size);
+		}
+
+		c = next;
+	}
+
+	auto header = (sizeof(chunk) + chunk_alignment - 1) / chunk_alignment * chunk_alignment;
+
+	_chunks       = largest;
+	_chunks->next = nullptr;
+	_begin        = reinterpret_cast<std::uint8_t*>(_chunks) + header;
+	_end          = reinterpret_cast<std::uint8_t*>(_chunks) + _chunks->size;
+}
+
+void arena::release() noexcept
+{
+	while (_chunks) {
+		auto next = _chunks->next;
+
+		_allocator->deallocate(_chunks, _chunks->size);
+
+		_chunks = next;
+	}
+
+	_capacity = 0;
+	_begin    = nullptr;
+	_end      = nullptr;
+}
+
+std::size_t arena::capacity() const noexcept
+{
+	return _capacity;
+}
+
+} // namespace memory
+} // namespace fast_cgi
\ No newline at end of file
@@ -3,13 +3,16 @@
 #include "fast_cgi/memory/buffer.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <limits>
 
 namespace fast_cgi {
 namespace memory {
 
-buffer::writer::writer(writer&& move) : _lock(std::move(move._lock))
+buffer::writer::writer(writer&& move)
 {
 	_buffer      = move._buffer;
+	_pending     = move._pending;
 	move._buffer = nullptr;
 }
 
@@ -24,42 +27,37 @@ std::pair<void*, std::size_t> buffer::writer::request_buffer(std::size_t desired
 		return { nullptr, 0 };
 	}
 
+	_publish();
+
 	// limit buffer to max size
-	desired = std::min(desired, _buffer->_max_size - _buffer->_write_total);
+	auto written = _buffer->_write_total.load(std::memory_order_relaxed);
+	auto max     = _buffer->_max_size.load(std::memory_order_acquire);
+
+	desired = written < max ? std::min(desired, max - written) : 0;
 
 	if (desired == 0) {
 		return { nullptr, 0 };
 	}
 
-	page* ptr = nullptr;
-
-	for (auto& page : _buffer->_pages) {
-		if (page.written < page.size) {
-			ptr = &page;
-
-			break;
-		}
-	}
+	auto ptr = _buffer->_tail;
 
 	// no space available
-	if (ptr == nullptr) {
+	if (!ptr || ptr->written.load(std::memory_order_relaxed) == ptr->size) {
 		ptr = &_buffer->append_new_page();
 	}
 
-	auto size  = std::min(ptr->size - ptr->written, desired);
-	auto begin = static_cast<std::int8_t*>(ptr->begin) + ptr->written;
+	auto offset = ptr->written.load(std::memory_order_relaxed);
+	auto size   = std::min(ptr->size - offset, desired);
 
-	ptr->written += size;
-	_buffer->_write_total += size;
+	_pending = size;
 
-	return { begin, size };
+	return { static_cast<std::int8_t*>(ptr->begin) + offset, size };
 }
 
 void buffer::writer::close() noexcept
 {
 	if (!closed()) {
-		_lock.unlock();
-		_buffer->_waiter.notify_one();
+		_publish();
 
 		_buffer = nullptr;
 	}
@@ -67,26 +65,63 @@ void buffer::writer::close() noexcept
 
 bool buffer::writer::closed() noexcept
 {
-	return _buffer == nullptr || !_lock.owns_lock();
+	return _buffer == nullptr;
 }
 
-buffer::writer::writer(buffer* buffer) : _lock(buffer->_mutex)
+buffer::writer::writer(buffer* buffer)
 {
-	_buffer = buffer;
+	_buffer  = buffer;
+	_pending = 0;
 }
 
-buffer::buffer(std::shared_ptr<allocator> allocator, std::size_t max_size) : _allocator(std::move(allocator))
+void buffer::writer::_publish() noexcept
 {
-	_interrupted   = false;
-	_write_total   = 0;
-	_consume_total = 0;
-	_max_size      = max_size;
+	if (_pending) {
+		auto page = _buffer->_tail;
+
+		page->written.store(page->written.load(std::memory_order_relaxed) + _pending, std::memory_order_release);
+		_buffer->_write_total.fetch_add(_pending, std::memory_order_release);
+
+		_pending = 0;
+
+		_buffer->_notify();
+	}
+}
+
+buffer::page::page(void* begin, std::size_t size) noexcept : begin(begin), size(size), written(0), next(nullptr)
+{
+	consumed = 0;
+}
+
+buffer::buffer(std::shared_ptr<allocator> allocator, std::size_t max_size, std::size_t min_page_size,
+               std::size_t max_page_size)
+    : _interrupted(false), _abandoned(false), _allocator(std::move(allocator)), _first(nullptr), _free(nullptr),
+      _free_count(0), _write_total(0), _consume_total(0), _max_size(max_size),
+      _capacity(std::numeric_limits<std::size_t>::max()), _waiting(0), _producer_waiting(false), _watcher(nullptr)
+{
+	_head           = nullptr;
+	_tail           = nullptr;
+	_spare          = nullptr;
+	_min_page_size  = min_page_size;
+	_max_page_size  = max_page_size;
+	_next_page_size = min_page_size;
 }
 
 buffer::~buffer()
 {
-	for (auto& page : _pages) {
-		_allocator->deallocate(page.begin, page.size);
+	// all pages before the head were recycled
+	page* lists[] = { _head ? _head : _first.load(std::memory_order_acquire), _free.load(std::memory_order_acquire),
+		              _spare };
+
+	for (auto page : lists) {
+		while (page) {
+			auto next = page->next.load(std::memory_order_relaxed);
+
+			_allocator->deallocate(page->begin, page->size);
+			delete page;
+
+			page = next;
+		}
 	}
 }
 
@@ -94,102 +129,184 @@ void buffer::interrupt_all_waiting()
 {
 	std::lock_guard<std::mutex> lock(_mutex);
 
-	_interrupted = true;
+	_interrupted.store(true, std::memory_order_release);
 	_waiter.notify_all();
 }
 
-bool buffer::interrupted()
+bool buffer::interrupted() noexcept
 {
-	std::lock_guard<std::mutex> lock(_mutex);
-
-	return _interrupted;
+	return _interrupted.load(std::memory_order_acquire);
 }
 
 void buffer::set_max(std::size_t max)
+{
+	_max_size.store(max, std::memory_order_release);
+
+	_notify();
+}
+
+void buffer::set_capacity(std::size_t capacity) noexcept
+{
+	_capacity.store(capacity, std::memory_order_relaxed);
+}
+
+bool buffer::wait_for_space(buffer* other)
+{
+	auto available = [this, other] {
+		return size() < _capacity.load(std::memory_order_relaxed) || _abandoned.load(std::memory_order_acquire) ||
+		       _interrupted.load(std::memory_order_acquire) || (other && other->consumer_waiting());
+	};
+
+	if (!available()) {
+		// announce the producer before checking again; pairs with the fences in wait_for_input() and _wait()
+		_producer_waiting.store(true, std::memory_order_relaxed);
+
+		if (other) {
+			other->_watcher.store(this, std::memory_order_relaxed);
+		}
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			_waiter.wait(lock, available);
+		}
+
+		_producer_waiting.store(false, std::memory_order_relaxed);
+
+		if (other) {
+			other->_watcher.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	return !_abandoned.load(std::memory_order_acquire) && !_interrupted.load(std::memory_order_acquire);
+}
+
+void buffer::abandon()
 {
 	std::lock_guard<std::mutex> lock(_mutex);
 
-	_max_size = max;
+	_abandoned.store(true, std::memory_order_release);
+	_waiter.notify_all();
+}
+
+bool buffer::abandoned() noexcept
+{
+	return _abandoned.load(std::memory_order_acquire);
 }
 
-void buffer::wait_for_all_input()
+bool buffer::consumer_waiting() noexcept
 {
-	std::unique_lock<std::mutex> lock(_mutex);
+	return _waiting.load(std::memory_order_acquire) > 0;
+}
+
+void buffer::reset(std::size_t max_size) noexcept
+{
+	// all pages before the head were recycled
+	auto page = _head ? _head : _first.load(std::memory_order_relaxed);
 
-	_waiter.wait(lock, [this] { return _write_total >= _max_size || _interrupted; });
+	while (page) {
+		auto next = page->next.load(std::memory_order_relaxed);
 
-	if (_interrupted) {
+		_recycle(page);
+
+		page = next;
+	}
+
+	_first.store(nullptr, std::memory_order_relaxed);
+
+	_head           = nullptr;
+	_tail           = nullptr;
+	_next_page_size = _min_page_size;
+
+	_write_total.store(0, std::memory_order_relaxed);
+	_consume_total.store(0, std::memory_order_relaxed);
+	_max_size.store(max_size, std::memory_order_relaxed);
+	_interrupted.store(false, std::memory_order_relaxed);
+	_abandoned.store(false, std::memory_order_release);
+}
+
+void buffer::wait_for_all_input()
+{
+	_wait([this] {
+		return _write_total.load(std::memory_order_acquire) >= _max_size.load(std::memory_order_acquire) ||
+		       _interrupted.load(std::memory_order_acquire);
+	});
+
+	if (_interrupted.load(std::memory_order_acquire)) {
 		throw exception::interrupted_error("waiting was interrupted");
 	}
 }
 
 std::pair<void*, std::size_t> buffer::wait_for_input()
 {
-	std::unique_lock<std::mutex> lock(_mutex);
 	page* ptr = nullptr;
 
-	FAST_CGI_LOG(TRACE, "waiting for input, consumed={} written={} max={}", _consume_total, _write_total, _max_size);
+	FAST_CGI_LOG(TRACE, "waiting for input, consumed={} written={} max={}", _consume_total.load(),
+	             _write_total.load(), _max_size.load());
 
 	// wait for input
-	_waiter.wait(lock, [this, &ptr] {
-		if (_interrupted) {
-			throw exception::interrupted_error("waiting was interrupted");
-		} // reached end
-		else if (_consume_total >= _max_size) {
+	_wait([this, &ptr] {
+		if (_interrupted.load(std::memory_order_acquire) ||
+		    _consume_total.load(std::memory_order_relaxed) >= _max_size.load(std::memory_order_acquire)) {
 			return true;
 		}
 
-		FAST_CGI_LOG(TRACE, "page count={}", _pages.size());
-
-		for (auto& page : _pages) {
-			FAST_CGI_LOG(TRACE, "page: consumed={} written={} max={}", page.consumed, page.written, page.size);
-
-			if (page.written > page.consumed) {
-				ptr = &page;
-
-				return true;
-			}
-		}
+		ptr = _readable_page();
 
-		return false;
+		return ptr != nullptr;
 	});
 
-	// reached end
-	if (_consume_total >= _max_size) {
+	if (_interrupted.load(std::memory_order_acquire)) {
+		throw exception::interrupted_error("waiting was interrupted");
+	} // reached end
+	else if (!ptr) {
 		return { nullptr, 0 };
 	}
 
-	auto begin = static_cast<std::int8_t*>(ptr->begin) + ptr->consumed;
-	auto size  = ptr->written - ptr->consumed;
+	auto written = ptr->written.load(std::memory_order_acquire);
+	auto begin   = static_cast<std::int8_t*>(ptr->begin) + ptr->consumed;
+	auto size    = written - ptr->consumed;
 
 	// update page
-	ptr->consumed = ptr->written;
-	_consume_total += size;
+	ptr->consumed = written;
+	_consume_total.fetch_add(size, std::memory_order_release);
+
+	// make room for a blocked producer; pairs with the fence in wait_for_space()
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (_producer_waiting.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_waiter.notify_all();
+	}
 
 	return { begin, size };
 }
 
 void buffer::close()
 {
-	std::lock_guard<std::mutex> lock(_mutex);
-
-	_max_size = _write_total;
+	_max_size.store(_write_total.load(std::memory_order_acquire), std::memory_order_release);
 
-	_waiter.notify_all();
+	_notify();
 }
 
 bool buffer::output_closed() noexcept
 {
-	std::lock_guard<std::mutex> lock(_mutex);
-
-	return _write_total >= _max_size;
+	return _write_total.load(std::memory_order_acquire) >= _max_size.load(std::memory_order_acquire);
 }
 
 bool buffer::input_closed() noexcept
 {
-	std::lock_guard<std::mutex> lock(_mutex);
+	return _consume_total.load(std::memory_order_acquire) >= _max_size.load(std::memory_order_acquire);
+}
 
-	return _consume_total >= _max_size;
+std::size_t buffer::size() noexcept
+{
+	auto consumed = _consume_total.load(std::memory_order_acquire);
+
+	return _write_total.load(std::memory_order_acquire) - consumed;
 }
 
 buffer::writer buffer::begin_writing()
@@ -199,15 +316,139 @@ buffer::writer buffer::begin_writing()
 
 buffer::page& buffer::append_new_page()
 {
-	page p{};
+	// take over all recycled pages
+	if (!_spare) {
+		_spare = _free.exchange(nullptr, std::memory_order_acquire);
+	}
+
+	page* p   = nullptr;
+	auto size = _next_page_size;
 
-	p.begin = _allocator->allocate(page::max_size, 1);
-	p.size  = page::max_size;
+	_next_page_size = std::min(_next_page_size * 2, _max_page_size);
 
-	_pages.push_back(p);
+	// recycled pages are reused if they are large enough
+	while (_spare) {
+		p      = _spare;
+		_spare = p->next.load(std::memory_order_relaxed);
+
+		_free_count.fetch_sub(1, std::memory_order_relaxed);
+
+		if (p->size >= size) {
+			break;
+		}
+
+		_allocator->deallocate(p->begin, p->size);
+		delete p;
+
+		p = nullptr;
+	}
+
+	if (p) {
+		p->written.store(0, std::memory_order_relaxed);
+		p->consumed = 0;
+		p->next.store(nullptr, std::memory_order_relaxed);
+	} else {
+		p = new page(_allocator->allocate(size, 1), size);
+	}
+
+	// link page
+	if (_tail) {
+		_tail->next.store(p, std::memory_order_release);
+	} else {
+		_first.store(p, std::memory_order_release);
+	}
+
+	_tail = p;
+
+	return *p;
+}
+
+buffer::page* buffer::_readable_page() noexcept
+{
+	if (!_head) {
+		_head = _first.load(std::memory_order_acquire);
+	}
 
-	return _pages.back();
+	while (_head) {
+		if (_head->written.load(std::memory_order_acquire) > _head->consumed) {
+			return _head;
+		} // page exhausted -> advance
+		else if (_head->consumed == _head->size) {
+			auto next = _head->next.load(std::memory_order_acquire);
+
+			if (!next) {
+				break;
+			}
+
+			// the input of this page was invalidated by this call
+			_recycle(_head);
+
+			_head = next;
+		} else {
+			break;
+		}
+	}
+
+	return nullptr;
+}
+
+void buffer::_recycle(page* page) noexcept
+{
+	// enough pages are kept
+	if (_free_count.load(std::memory_order_relaxed) >= page::max_free) {
+		_allocator->deallocate(page->begin, page->size);
+		delete page;
+
+		return;
+	}
+
+	_free_count.fetch_add(1, std::memory_order_relaxed);
+
+	auto head = _free.load(std::memory_order_relaxed);
+
+	do {
+		page->next.store(head, std::memory_order_relaxed);
+	} while (!_free.compare_exchange_weak(head, page, std::memory_order_release, std::memory_order_relaxed));
+}
+
+template<typename Predicate>
+void buffer::_wait(Predicate predicate)
+{
+	if (predicate()) {
+		return;
+	}
+
+	// announce the waiter before checking again; pairs with the fence in _notify()
+	_waiting.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// the producer of another buffer waits until this consumer blocks; pairs with the fence in wait_for_space()
+	if (auto watcher = _watcher.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(watcher->_mutex);
+
+		watcher->_waiter.notify_all();
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		_waiter.wait(lock, predicate);
+	}
+
+	_waiting.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void buffer::_notify()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// only lock if someone is actually blocking
+	if (_waiting.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_waiter.notify_all();
+	}
 }
 
+} // namespace memory
 } // namespace fast_cgi
-} // namespace fast_cgi
\ No newline at end of file
@@ -1,66 +1,248 @@
 #include "fast_cgi/log.hpp"
 #include "fast_cgi/memory/buffer_manager.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <utility>
+
 namespace fast_cgi {
 namespace memory {
 
-buffer_manager::buffer_manager(std::size_t page_size, std::shared_ptr<allocator> allocator)
-    : _allocator(std::move(allocator))
+struct buffer_manager::header
+{
+	std::atomic<std::size_t> references;
+	buffer_manager* owner;
+	/** the size class */
+	std::size_t index;
+	/** the next free page */
+	header* next;
+	/** the neighbours in the list of all pages */
+	header* previous_page;
+	header* next_page;
+};
+
+struct buffer_manager::free_list
+{
+	std::atomic<header*> head;
+	std::atomic<std::size_t> count;
+};
+
+const std::size_t buffer_manager::_header_size =
+    (sizeof(header) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+page_handle::page_handle() noexcept
 {
-	_page_size = page_size;
+	_page = nullptr;
 }
 
-buffer_manager::~buffer_manager()
+page_handle::page_handle(const page_handle& copy) noexcept
+{
+	_page = copy._page;
+
+	if (_page) {
+		buffer_manager::_header(_page)->references.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+page_handle::page_handle(page_handle&& move) noexcept
+{
+	_page      = move._page;
+	move._page = nullptr;
+}
+
+page_handle::~page_handle()
+{
+	if (_page) {
+		buffer_manager::_release(buffer_manager::_header(_page));
+	}
+}
+
+page_handle& page_handle::operator=(page_handle other) noexcept
+{
+	std::swap(_page, other._page);
+
+	return *this;
+}
+
+void* page_handle::get() const noexcept
+{
+	return _page;
+}
+
+page_handle::operator bool() const noexcept
+{
+	return _page != nullptr;
+}
+
+page_handle::page_handle(void* page) noexcept
+{
+	_page = page;
+}
+
+buffer_manager::buffer_manager(std::size_t page_size, std::shared_ptr<allocator> allocator)
+    : _allocator(std::move(allocator))
 {
-	for (auto& page : _pages) {
-		_allocator->deallocate(page, _page_size);
+	_page_size   = page_size;
+	_class_count = 1;
+	_pages       = nullptr;
+
+	while ((_page_size << (_class_count - 1)) < max_page_size) {
+		++_class_count;
 	}
 
-	for (auto& page : _free_pages) {
-		_allocator->deallocate(page.first, _page_size);
+	_free_pages.reset(new free_list[_class_count]);
+
+	for (std::size_t i = 0; i < _class_count; ++i) {
+		_free_pages[i].head.store(nullptr, std::memory_order_relaxed);
+		_free_pages[i].count.store(0, std::memory_order_relaxed);
 	}
 }
 
-void buffer_manager::free_page(void* page, std::shared_ptr<std::atomic_bool> tracker)
+buffer_manager::~buffer_manager()
 {
-	auto result = _pages.find(page);
+	for (auto page = _pages; page;) {
+		auto next = page->next_page;
 
-	if (result != _pages.end()) {
-		auto ptr = *result;
+		if (page->references.load(std::memory_order_relaxed)) {
+			FAST_CGI_LOG(DEBUG, "releasing referenced page: {}", static_cast<void*>(page));
+		}
 
-		_pages.erase(result);
+		_allocator->deallocate(page, _page_size << page->index);
 
-		_free_pages.push_back({ ptr, std::move(tracker) });
-	} else {
-		FAST_CGI_LOG(CRITICAL, "requesting freeing of unkown page: {}", page);
+		page = next;
 	}
 }
 
+void buffer_manager::free_page(void* page) noexcept
+{
+	_release(_header(page));
+}
+
 void* buffer_manager::new_page()
 {
-	// check for free page
-	for (auto i = _free_pages.begin(); i != _free_pages.end(); ++i) {
-		if (!i->second || i->second->load(std::memory_order_acquire)) {
-			auto ptr = i->first;
+	return new_page(0);
+}
+
+void* buffer_manager::new_page(std::size_t size)
+{
+	std::size_t index = 0;
+
+	while (index + 1 < _class_count && (_page_size << index) - _header_size < size) {
+		++index;
+	}
+
+	auto& list   = _free_pages[index];
+	header* page = nullptr;
+
+	// pop free page
+	{
+		std::lock_guard<std::mutex> lock(_pop_mutex);
 
-			_free_pages.erase(i);
-			_pages.insert(ptr);
+		page = list.head.load(std::memory_order_acquire);
 
-			return ptr;
+		while (page && !list.head.compare_exchange_weak(page, page->next, std::memory_order_acquire,
+		                                                std::memory_order_acquire)) {
 		}
 	}
 
-	// allocate new page
-	auto ptr = _allocator->allocate(_page_size, 1);
+	if (page) {
+		list.count.fetch_sub(1, std::memory_order_relaxed);
+	} // allocate new page
+	else {
+		page = static_cast<header*>(_allocator->allocate(_page_size << index, alignof(std::max_align_t)));
+
+		new (page) header{};
+
+		page->owner = this;
+		page->index = index;
+
+		std::lock_guard<std::mutex> lock(_pages_mutex);
 
-	_pages.insert(ptr);
+		page->next_page = _pages;
 
-	return ptr;
+		if (_pages) {
+			_pages->previous_page = page;
+		}
+
+		_pages = page;
+	}
+
+	page->references.store(1, std::memory_order_relaxed);
+
+	return reinterpret_cast<std::uint8_t*>(page) + _header_size;
+}
+
+page_handle buffer_manager::adopt(void* page) noexcept
+{
+	return page_handle(page);
 }
 
 std::size_t buffer_manager::page_size() const noexcept
 {
-	return _page_size;
+	return _page_size - _header_size;
+}
+
+std::size_t buffer_manager::page_size(void* page) noexcept
+{
+	auto h = _header(page);
+
+	return (h->owner->_page_size << h->index) - _header_size;
+}
+
+std::size_t buffer_manager::max_size() const noexcept
+{
+	return (_page_size << (_class_count - 1)) - _header_size;
+}
+
+buffer_manager::header* buffer_manager::_header(void* page) noexcept
+{
+	return reinterpret_cast<header*>(static_cast<std::uint8_t*>(page) - _header_size);
+}
+
+void buffer_manager::_release(header* header) noexcept
+{
+	if (header->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		header->owner->_push(header);
+	}
+}
+
+void buffer_manager::_push(header* header) noexcept
+{
+	auto& list = _free_pages[header->index];
+
+	// enough pages are kept
+	if (list.count.fetch_add(1, std::memory_order_relaxed) >= std::max<std::size_t>(max_free >> header->index, 1)) {
+		list.count.fetch_sub(1, std::memory_order_relaxed);
+		_deallocate(header);
+
+		return;
+	}
+
+	header->next = list.head.load(std::memory_order_relaxed);
+
+	while (!list.head.compare_exchange_weak(header->next, header, std::memory_order_release,
+	                                        std::memory_order_relaxed)) {
+	}
+}
+
+void buffer_manager::_deallocate(header* header) noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(_pages_mutex);
+
+		if (header->previous_page) {
+			header->previous_page->next_page = header->next_page;
+		} else {
+			_pages = header->next_page;
+		}
+
+		if (header->next_page) {
+			header->next_page->previous_page = header->previous_page;
+		}
+	}
+
+	_allocator->deallocate(header, _page_size << header->index);
 }
 
 } // namespace memory
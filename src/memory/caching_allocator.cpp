@@ -0,0 +1,258 @@
+#include "fast_cgi/memory/caching_allocator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace fast_cgi {
+namespace memory {
+
+namespace {
+
+constexpr std::size_t class_count = 11;
+
+static_assert(caching_allocator::min_class_size << (class_count - 1) == caching_allocator::max_class_size,
+              "invalid size classes");
+
+struct block
+{
+	block* next;
+};
+
+std::size_t class_of(std::size_t size) noexcept
+{
+	std::size_t index = 0;
+
+	for (auto s = caching_allocator::min_class_size; s < size; s <<= 1) {
+		++index;
+	}
+
+	return index;
+}
+
+constexpr std::size_t size_of(std::size_t index) noexcept
+{
+	return caching_allocator::min_class_size << index;
+}
+
+/**
+  Allocates memory with the given alignment. The original pointer is stored in front of the returned memory.
+ */
+void* aligned_malloc(std::size_t size, std::size_t align)
+{
+	auto ptr = std::malloc(size + align + sizeof(void*));
+
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+
+	auto address = (reinterpret_cast<std::uintptr_t>(ptr) + sizeof(void*) + align - 1) & ~(align - 1);
+	auto aligned = reinterpret_cast<void*>(address);
+
+	static_cast<void**>(aligned)[-1] = ptr;
+
+	return aligned;
+}
+
+void aligned_free(void* ptr) noexcept
+{
+	if (ptr) {
+		std::free(static_cast<void**>(ptr)[-1]);
+	}
+}
+
+} // namespace
+
+struct caching_allocator::depot
+{
+	struct list
+	{
+		block* head;
+		std::size_t count;
+	};
+
+	mutable std::mutex mutex;
+	std::array<list, class_count> lists;
+	std::vector<void*> slabs;
+	caching_allocator::statistics counters;
+
+	depot() : lists(), counters()
+	{}
+	~depot()
+	{
+		for (auto slab : slabs) {
+			aligned_free(slab);
+		}
+	}
+	/**
+	  Moves up to `batch_size` blocks into the given list. A new slab is created if the depot is empty.
+	 */
+	void take(std::size_t index, list& target)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& source = lists[index];
+
+		++counters.depot_transfers;
+
+		if (source.count) {
+			for (std::size_t i = 0; i < batch_size && source.head; ++i) {
+				auto b      = source.head;
+				source.head = b->next;
+				b->next     = target.head;
+				target.head = b;
+
+				--source.count;
+				--counters.depot_blocks;
+				++target.count;
+			}
+
+			return;
+		}
+
+		// carve a new slab; every block is aligned to its size
+		auto size  = size_of(index);
+		auto align = std::max(size, std::size_t(alignment));
+		auto slab  = static_cast<std::uint8_t*>(aligned_malloc(size * batch_size, align));
+
+		slabs.push_back(slab);
+		counters.reserved += size * batch_size;
+
+		for (std::size_t i = 0; i < batch_size; ++i) {
+			auto b      = reinterpret_cast<block*>(slab + i * size);
+			b->next     = target.head;
+			target.head = b;
+		}
+
+		target.count += batch_size;
+	}
+	/**
+	  Moves up to *count* blocks from the given list into the depot.
+	 */
+	void give(std::size_t index, list& source, std::size_t count)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& target = lists[index];
+
+		++counters.depot_transfers;
+
+		for (std::size_t i = 0; i < count && source.head; ++i) {
+			auto b      = source.head;
+			source.head = b->next;
+			b->next     = target.head;
+			target.head = b;
+
+			--source.count;
+			++counters.depot_blocks;
+			++target.count;
+		}
+	}
+};
+
+struct caching_allocator::thread_cache
+{
+	std::shared_ptr<caching_allocator::depot> owner;
+	std::array<caching_allocator::depot::list, class_count> lists;
+
+	thread_cache(std::shared_ptr<caching_allocator::depot> owner) : owner(std::move(owner)), lists()
+	{}
+	~thread_cache()
+	{
+		for (std::size_t i = 0; i < class_count; ++i) {
+			if (lists[i].count) {
+				owner->give(i, lists[i], lists[i].count);
+			}
+		}
+	}
+};
+
+caching_allocator::caching_allocator() : _depot(std::make_shared<depot>())
+{}
+
+void* caching_allocator::allocate(std::size_t size, std::size_t align)
+{
+	if (align & (align - 1)) {
+		throw std::invalid_argument("alignment must be a power of two");
+	} else if (size > max_class_size) {
+		{
+			std::lock_guard<std::mutex> lock(_depot->mutex);
+
+			++_depot->counters.large_allocations;
+		}
+
+		return aligned_malloc(size, std::max(align, std::size_t(alignment)));
+	}
+
+	auto index = class_of(size);
+
+	// the block is only aligned to its size; a larger class cannot be used because it would be freed to this one
+	if (align > std::max(size_of(index), std::size_t(alignment))) {
+		throw std::invalid_argument("alignment exceeds the size class");
+	}
+
+	auto& list = _thread_cache().lists[index];
+
+	if (!list.head) {
+		_depot->take(index, list);
+	}
+
+	auto b    = list.head;
+	list.head = b->next;
+
+	--list.count;
+
+	return b;
+}
+
+void caching_allocator::deallocate(void* ptr, std::size_t size)
+{
+	if (!ptr) {
+		return;
+	} else if (size > max_class_size) {
+		aligned_free(ptr);
+
+		return;
+	}
+
+	auto index = class_of(size);
+	auto& list = _thread_cache().lists[index];
+	auto b     = static_cast<block*>(ptr);
+
+	b->next   = list.head;
+	list.head = b;
+
+	// give blocks freed by a consumer thread back to the producer threads
+	if (++list.count >= 2 * batch_size) {
+		_depot->give(index, list, batch_size);
+	}
+}
+
+caching_allocator::statistics caching_allocator::stats() const
+{
+	std::lock_guard<std::mutex> lock(_depot->mutex);
+
+	return _depot->counters;
+}
+
+caching_allocator::thread_cache& caching_allocator::_thread_cache()
+{
+	// the caches of all allocators used by this thread
+	thread_local std::vector<std::unique_ptr<thread_cache>> caches;
+
+	for (auto& cache : caches) {
+		if (cache->owner == _depot) {
+			return *cache;
+		}
+	}
+
+	caches.emplace_back(new thread_cache(_depot));
+
+	return *caches.back();
+}
+
+} // namespace memory
+} // namespace fast_cgi
\ No newline at end of file
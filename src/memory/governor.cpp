@@ -0,0 +1,130 @@
+#include "fast_cgi/log.hpp"
+#include "fast_cgi/memory/governor.hpp"
+
+namespace fast_cgi {
+namespace memory {
+
+class governor::tracker : public allocator
+{
+public:
+	tracker(std::shared_ptr<governor> governor, std::shared_ptr<allocator> allocator, CATEGORY category)
+	    : _governor(std::move(governor)), _allocator(std::move(allocator)), _category(category)
+	{}
+	virtual void* allocate(std::size_t size, std::size_t align) override
+	{
+		auto ptr = _allocator->allocate(size, align);
+
+		_governor->_add(_category, size);
+
+		return ptr;
+	}
+	virtual void deallocate(void* ptr, std::size_t size) override
+	{
+		_allocator->deallocate(ptr, size);
+		_governor->_remove(_category, size);
+	}
+
+private:
+	std::shared_ptr<governor> _governor;
+	std::shared_ptr<allocator> _allocator;
+	CATEGORY _category;
+};
+
+constexpr std::chrono::milliseconds governor::drain_interval;
+
+governor::governor(std::size_t limit) : _limit(limit), _used(0), _peak(0), _refused(0), _throttled(0), _waiting(0)
+{
+	for (auto& category : _categories) {
+		category.store(0, std::memory_order_relaxed);
+	}
+}
+
+std::shared_ptr<allocator> governor::track(std::shared_ptr<allocator> allocator, CATEGORY category)
+{
+	return std::make_shared<tracker>(shared_from_this(), std::move(allocator), category);
+}
+
+bool governor::under_pressure() const noexcept
+{
+	return _used.load(std::memory_order_relaxed) >= _limit;
+}
+
+void governor::throttle(const std::function<bool()>& drained)
+{
+	if (!under_pressure() || drained()) {
+		return;
+	}
+
+	FAST_CGI_LOG(DEBUG, "memory limit exceeded; throttling");
+
+	_throttled.fetch_add(1, std::memory_order_relaxed);
+	_waiting.fetch_add(1);
+
+	// woken up when the usage drops below the limit; draining does not free memory and is checked periodically
+	while (!drained()) {
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		if (_used.load() < _limit) {
+			break;
+		}
+
+		_relief.wait_for(lock, drain_interval);
+	}
+
+	_waiting.fetch_sub(1);
+}
+
+void governor::refuse() noexcept
+{
+	_refused.fetch_add(1, std::memory_order_relaxed);
+}
+
+governor::statistics governor::stats() const noexcept
+{
+	statistics stats{};
+
+	stats.used = _used.load(std::memory_order_relaxed);
+	stats.peak = _peak.load(std::memory_order_relaxed);
+
+	for (std::size_t i = 0; i < category_count; ++i) {
+		stats.categories[i] = _categories[i].load(std::memory_order_relaxed);
+	}
+
+	stats.refused   = _refused.load(std::memory_order_relaxed);
+	stats.throttled = _throttled.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+std::size_t governor::limit() const noexcept
+{
+	return _limit;
+}
+
+void governor::_add(CATEGORY category, std::size_t size) noexcept
+{
+	_categories[static_cast<std::size_t>(category)].fetch_add(size, std::memory_order_relaxed);
+
+	auto used = _used.fetch_add(size, std::memory_order_relaxed) + size;
+	auto peak = _peak.load(std::memory_order_relaxed);
+
+	while (used > peak && !_peak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
+	}
+}
+
+void governor::_remove(CATEGORY category, std::size_t size) noexcept
+{
+	_categories[static_cast<std::size_t>(category)].fetch_sub(size, std::memory_order_relaxed);
+
+	auto used = _used.fetch_sub(size);
+
+	// the pressure is relieved
+	if (used >= _limit && used - size < _limit && _waiting.load()) {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_relief.notify_all();
+	}
+}
+
+} // namespace memory
+} // namespace fast_cgi
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "fast_cgi/log.hpp"
+#include "fast_cgi/memory/buffer.hpp"
+#include "fast_cgi/memory/buffer_manager.hpp"
+#include "fast_cgi/memory/huge_page_allocator.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+#if defined(__linux__)
+#	include <sys/mman.h>
+#endif
+
+namespace fast_cgi {
+namespace memory {
+
+namespace {
+
+/** the size of a normal page */
+constexpr std::size_t system_page_size = 4096;
+
+static_assert(huge_page_allocator::max_block_size >= buffer::default_max_page_size &&
+                  huge_page_allocator::max_block_size >= buffer_manager::max_page_size,
+              "the largest pages of the buffers are not carved out of the regions");
+
+std::size_t class_of(std::size_t size) noexcept
+{
+	std::size_t index = 0;
+
+	for (auto s = huge_page_allocator::min_block_size; s < size; s <<= 1) {
+		++index;
+	}
+
+	return index;
+}
+
+constexpr std::size_t size_of(std::size_t index) noexcept
+{
+	return huge_page_allocator::min_block_size << index;
+}
+
+char* align_up(char* ptr, std::size_t align) noexcept
+{
+	return reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(ptr) + align - 1) & ~(align - 1));
+}
+
+} // namespace
+
+huge_page_allocator::huge_page_allocator(std::size_t region_size, std::size_t prefault)
+{
+	_region_size = region_size;
+	_begin       = nullptr;
+	_end         = nullptr;
+	_statistics  = {};
+
+	for (auto& list : _free) {
+		list = nullptr;
+	}
+
+	static_assert(min_block_size << (class_count - 1) == max_block_size, "invalid size classes");
+
+	for (std::size_t mapped = 0; mapped < prefault; mapped += _region_size) {
+		_map_region(true);
+	}
+}
+
+huge_page_allocator::~huge_page_allocator()
+{
+	for (auto& region : _regions) {
+		_unmap_region(region);
+	}
+}
+
+void* huge_page_allocator::allocate(std::size_t size, std::size_t align)
+{
+	if (align & (align - 1)) {
+		throw std::invalid_argument("alignment must be a power of two");
+	} else if (size > max_block_size) {
+		void* ptr = nullptr;
+
+#if defined(__linux__)
+		if (posix_memalign(&ptr, std::max(align, sizeof(void*)), size)) {
+			ptr = nullptr;
+		}
+#else
+		if (align > alignof(std::max_align_t)) {
+			throw std::invalid_argument("alignment exceeds the alignment of std::malloc()");
+		}
+
+		ptr = std::malloc(size);
+#endif
+
+		if (!ptr) {
+			throw std::bad_alloc();
+		}
+
+		return ptr;
+	}
+
+	auto index      = class_of(size);
+	auto block_size = size_of(index);
+
+	// the block is only aligned to its size; a larger class cannot be used because it would be freed to this one
+	if (align > block_size) {
+		throw std::invalid_argument("alignment exceeds the size class");
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	// reuse a freed block
+	if (auto b = _free[index]) {
+		_free[index] = b->next;
+
+		return b;
+	}
+
+	// carve from the current region
+	auto ptr = align_up(_begin, block_size);
+
+	if (reinterpret_cast<std::uintptr_t>(ptr) + block_size > reinterpret_cast<std::uintptr_t>(_end)) {
+		_map_region(false);
+
+		ptr = align_up(_begin, block_size);
+	}
+
+	// the gap in front of the block is split into smaller blocks
+	_release(_begin, ptr);
+
+	_begin = ptr + block_size;
+
+	return ptr;
+}
+
+void huge_page_allocator::deallocate(void* ptr, std::size_t size)
+{
+	if (size > max_block_size) {
+		std::free(ptr);
+
+		return;
+	}
+
+	auto index = class_of(size);
+	auto b     = static_cast<block*>(ptr);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	b->next      = _free[index];
+	_free[index] = b;
+}
+
+huge_page_allocator::statistics huge_page_allocator::stats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	return _statistics;
+}
+
+void huge_page_allocator::_map_region(bool prefault)
+{
+	// return the rest of the old region to the free lists
+	_release(_begin, _end);
+
+	region r{ nullptr, _region_size, false };
+
+#if defined(__linux__)
+#	if defined(MAP_HUGETLB)
+	// only succeeds if huge pages are reserved
+	r.begin = mmap(nullptr, _region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+	if (r.begin == MAP_FAILED) {
+		r.begin = nullptr;
+	} else {
+		r.hugetlb = true;
+	}
+#	endif
+
+	if (!r.begin) {
+		// over-allocate to align the region to the huge page size
+		auto size = _region_size + default_region_size;
+		auto ptr  = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (ptr == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
+
+		auto address = reinterpret_cast<std::uintptr_t>(ptr);
+		auto aligned = (address + default_region_size - 1) & ~(default_region_size - 1);
+		auto head    = aligned - address;
+
+		if (head) {
+			munmap(ptr, head);
+		}
+
+		munmap(reinterpret_cast<char*>(aligned) + _region_size, size - head - _region_size);
+
+		r.begin = reinterpret_cast<void*>(aligned);
+
+#	if defined(MADV_HUGEPAGE)
+		if (madvise(r.begin, _region_size, MADV_HUGEPAGE) == 0) {
+			++_statistics.advised_regions;
+		} else {
+			FAST_CGI_LOG(DEBUG, "transparent huge pages are not available");
+		}
+#	endif
+	}
+#else
+	r.begin = std::malloc(_region_size);
+
+	if (!r.begin) {
+		throw std::bad_alloc();
+	}
+#endif
+
+	_regions.push_back(r);
+
+	// touch every page
+	if (prefault) {
+		for (std::size_t offset = 0; offset < _region_size; offset += system_page_size) {
+			static_cast<volatile char*>(r.begin)[offset] = 0;
+		}
+	}
+
+	_statistics.reserved += _region_size;
+	_statistics.regions += 1;
+	_statistics.hugetlb_regions += r.hugetlb ? 1 : 0;
+
+	FAST_CGI_LOG(DEBUG, "mapped region of {} bytes (hugetlb: {})", _region_size, r.hugetlb);
+
+	_begin = align_up(static_cast<char*>(r.begin), min_block_size);
+	_end   = static_cast<char*>(r.begin) + _region_size;
+}
+
+void huge_page_allocator::_release(char* begin, char* end) noexcept
+{
+	while (static_cast<std::size_t>(end - begin) >= min_block_size) {
+		auto address = reinterpret_cast<std::uintptr_t>(begin);
+		auto index   = class_count - 1;
+
+		// the largest block that is aligned to its size and fits
+		while (index && (address % size_of(index) || static_cast<std::size_t>(end - begin) < size_of(index))) {
+			--index;
+		}
+
+		auto b = reinterpret_cast<block*>(begin);
+
+		b->next      = _free[index];
+		_free[index] = b;
+		begin += size_of(index);
+	}
+}
+
+void huge_page_allocator::_unmap_region(const region& region) noexcept
+{
+#if defined(__linux__)
+	munmap(region.begin, region.size);
+#else
+	std::free(region.begin);
+#endif
+}
+
+} // namespace memory
+} // namespace fast_cgi
\ No newline at end of file
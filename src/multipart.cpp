@@ -0,0 +1,396 @@
+#include "fast_cgi/multipart.hpp"
+#include "fast_cgi/exception/parse_error.hpp"
+#include "fast_cgi/io/byte_stream.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#elif defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+namespace fast_cgi {
+
+namespace {
+
+constexpr auto npos = string_view::npos;
+
+/**
+  Searches the delimiter. Candidates are found by comparing the first and the last byte of the delimiter at 32 or 16
+  positions at once if the target supports AVX2 or SSE2; only those are compared completely.
+
+  @returns the position or `npos`
+ */
+std::size_t find_delimiter(const char* data, std::size_t size, const std::string& delimiter) noexcept
+{
+	const auto length = delimiter.size();
+	std::size_t i     = 0;
+
+	if (size < length) {
+		return npos;
+	}
+
+#if defined(__AVX2__)
+	const auto first = _mm256_set1_epi8(delimiter.front());
+	const auto last  = _mm256_set1_epi8(delimiter.back());
+
+	for (; i + length - 1 + 32 <= size; i += 32) {
+		auto begin = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		auto end   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + length - 1));
+		auto mask  = static_cast<unsigned int>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(begin, first), _mm256_cmpeq_epi8(end, last))));
+
+		for (; mask; mask &= mask - 1) {
+			auto position = i + __builtin_ctz(mask);
+
+			if (std::memcmp(data + position + 1, delimiter.data() + 1, length - 2) == 0) {
+				return position;
+			}
+		}
+	}
+#elif defined(__SSE2__)
+	const auto first = _mm_set1_epi8(delimiter.front());
+	const auto last  = _mm_set1_epi8(delimiter.back());
+
+	for (; i + length - 1 + 16 <= size; i += 16) {
+		auto begin = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		auto end   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + length - 1));
+		auto mask  = static_cast<unsigned int>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(begin, first), _mm_cmpeq_epi8(end, last))));
+
+		for (; mask; mask &= mask - 1) {
+			auto position = i + __builtin_ctz(mask);
+
+			if (std::memcmp(data + position + 1, delimiter.data() + 1, length - 2) == 0) {
+				return position;
+			}
+		}
+	}
+#endif
+
+	while (i + length <= size) {
+		auto candidate = static_cast<const char*>(std::memchr(data + i, delimiter.front(), size - length + 1 - i));
+
+		if (!candidate) {
+			break;
+		}
+
+		i = static_cast<std::size_t>(candidate - data);
+
+		if (std::memcmp(candidate, delimiter.data(), length) == 0) {
+			return i;
+		}
+
+		++i;
+	}
+
+	return npos;
+}
+
+inline char lower(char c) noexcept
+{
+	return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool equals_ignore_case(string_view left, string_view right) noexcept
+{
+	return left.size() == right.size() &&
+	       std::equal(left.begin(), left.end(), right.begin(), [](char l, char r) { return lower(l) == lower(r); });
+}
+
+string_view trim(string_view value) noexcept
+{
+	auto begin = value.begin();
+	auto end   = value.end();
+
+	while (begin != end && (*begin == ' ' || *begin == '\t')) {
+		++begin;
+	}
+
+	while (end != begin && (end[-1] == ' ' || end[-1] == '\t')) {
+		--end;
+	}
+
+	return { begin, static_cast<std::size_t>(end - begin) };
+}
+
+} // namespace
+
+multipart::multipart(string_view boundary, part_handler_type part_handler, data_handler_type data_handler,
+                     end_handler_type end_handler, std::size_t max_header_size)
+    : _delimiter("\r\n--"), _part_handler(std::move(part_handler)), _data_handler(std::move(data_handler)),
+      _end_handler(std::move(end_handler)), _max_header_size(max_header_size), _state(STATE::preamble)
+{
+	_delimiter.append(boundary.data(), boundary.size());
+
+	// the first boundary may be at the very beginning
+	_carry = "\r\n";
+}
+
+void multipart::feed(string_view chunk)
+{
+	auto data = chunk.data();
+	auto size = chunk.size();
+
+	while (size) {
+		std::size_t consumed = 0;
+
+		switch (_state) {
+		case STATE::preamble:
+		case STATE::body: consumed = _consume_body(data, size); break;
+		case STATE::boundary_line:
+		case STATE::boundary_dash:
+		case STATE::boundary_end: consumed = _consume_boundary_line(data, size); break;
+		case STATE::headers: consumed = _consume_headers(data, size); break;
+		case STATE::finished: return;
+		}
+
+		data += consumed;
+		size -= consumed;
+	}
+}
+
+void multipart::parse(std::istream& input)
+{
+	// parse the pages directly
+	if (auto pages = dynamic_cast<io::input_streambuf*>(input.rdbuf())) {
+		for (auto chunk = pages->read_chunk(); chunk.second; chunk = pages->read_chunk()) {
+			feed({ chunk.first, chunk.second });
+		}
+	} else {
+		char buffer[4096];
+
+		while (input.read(buffer, sizeof(buffer)), input.gcount()) {
+			feed({ buffer, static_cast<std::size_t>(input.gcount()) });
+		}
+	}
+
+	if (!finished()) {
+		throw exception::parse_error("multipart content ended before the final boundary");
+	}
+}
+
+bool multipart::finished() const noexcept
+{
+	return _state == STATE::finished;
+}
+
+string_view multipart::boundary_of(string_view content_type) noexcept
+{
+	return parameter(content_type, "boundary");
+}
+
+string_view multipart::header(string_view headers, string_view name) noexcept
+{
+	auto data = headers.data();
+	auto end  = data + headers.size();
+
+	while (data != end) {
+		auto line_end = std::search(data, end, "\r\n", "\r\n" + 2);
+		auto colon    = std::find(data, line_end, ':');
+
+		if (colon != line_end && equals_ignore_case(trim({ data, static_cast<std::size_t>(colon - data) }), name)) {
+			return trim({ colon + 1, static_cast<std::size_t>(line_end - colon - 1) });
+		}
+
+		data = line_end == end ? end : line_end + 2;
+	}
+
+	return {};
+}
+
+string_view multipart::parameter(string_view value, string_view name) noexcept
+{
+	// the end of the token starting at *i*; separators in quotes are ignored
+	auto token_end = [value](std::size_t i) {
+		auto quoted = false;
+
+		for (; i < value.size() && (quoted || value[i] != ';'); ++i) {
+			if (value[i] == '"') {
+				quoted = !quoted;
+			}
+		}
+
+		return i;
+	};
+
+	// the first token is the value itself
+	for (auto begin = token_end(0) + 1; begin < value.size();) {
+		auto end    = token_end(begin);
+		auto token  = trim({ value.data() + begin, end - begin });
+		auto equals = token.find('=');
+
+		if (equals != npos && equals_ignore_case(trim({ token.data(), equals }), name)) {
+			auto result = trim({ token.data() + equals + 1, token.size() - equals - 1 });
+
+			if (result.size() >= 2 && result[0] == '"' && result[result.size() - 1] == '"') {
+				return { result.data() + 1, result.size() - 2 };
+			}
+
+			return result;
+		}
+
+		begin = end + 1;
+	}
+
+	return {};
+}
+
+std::size_t multipart::_consume_body(const char* data, std::size_t size)
+{
+	if (!_carry.empty()) {
+		auto consumed = _consume_carry(data, size);
+
+		if (consumed || !_carry.empty()) {
+			return consumed;
+		}
+	}
+
+	const auto length = _delimiter.size();
+	auto position     = find_delimiter(data, size, _delimiter);
+
+	if (position != npos) {
+		_emit(data, position);
+		_delimiter_found();
+
+		return position + length;
+	}
+
+	// keep the end if it could be the start of the delimiter
+	auto tail = size > length - 1 ? size - (length - 1) : 0;
+
+	while (tail < size) {
+		auto candidate = static_cast<const char*>(std::memchr(data + tail, _delimiter.front(), size - tail));
+
+		if (!candidate) {
+			tail = size;
+		} else if (std::memcmp(candidate, _delimiter.data(), data + size - candidate) == 0) {
+			tail = static_cast<std::size_t>(candidate - data);
+
+			break;
+		} else {
+			tail = static_cast<std::size_t>(candidate - data) + 1;
+		}
+	}
+
+	_emit(data, tail);
+	_carry.assign(data + tail, size - tail);
+
+	return size;
+}
+
+std::size_t multipart::_consume_carry(const char* data, std::size_t size)
+{
+	const auto length     = _delimiter.size();
+	const auto carry_size = _carry.size();
+
+	_carry.append(data, std::min(size, length));
+
+	for (std::size_t i = 0; i < carry_size; ++i) {
+		auto available = _carry.size() - i;
+
+		if (available >= length && std::memcmp(_carry.data() + i, _delimiter.data(), length) == 0) {
+			_emit(_carry.data(), i);
+			_carry.clear();
+			_delimiter_found();
+
+			return i + length - carry_size;
+		} // the chunk is too small to decide
+		else if (available < length && std::memcmp(_carry.data() + i, _delimiter.data(), available) == 0) {
+			_emit(_carry.data(), i);
+			_carry.erase(0, i);
+
+			return size;
+		}
+	}
+
+	_emit(_carry.data(), carry_size);
+	_carry.clear();
+
+	return 0;
+}
+
+std::size_t multipart::_consume_boundary_line(const char* data, std::size_t size) noexcept
+{
+	for (std::size_t i = 0; i < size; ++i) {
+		auto c = data[i];
+
+		switch (_state) {
+		case STATE::boundary_line:
+			if (c == '-') {
+				_state = STATE::boundary_dash;
+			} else if (c == '\r') {
+				_state = STATE::boundary_end;
+			}
+
+			break;
+		case STATE::boundary_dash:
+			// the final boundary; ignore the epilogue
+			if (c == '-') {
+				_state = STATE::finished;
+
+				return size;
+			}
+
+			_state = STATE::boundary_line;
+
+			break;
+		default:
+			if (c == '\n') {
+				_state = STATE::headers;
+				_headers.assign("\r\n");
+
+				return i + 1;
+			} else if (c != '\r') {
+				_state = STATE::boundary_line;
+			}
+
+			break;
+		}
+	}
+
+	return size;
+}
+
+std::size_t multipart::_consume_headers(const char* data, std::size_t size)
+{
+	const auto old_size = _headers.size();
+
+	_headers.append(data, size);
+
+	auto position = _headers.find("\r\n\r\n", old_size >= 3 ? old_size - 3 : 0);
+
+	if ((position == std::string::npos ? _headers.size() : position) > _max_header_size + 2) {
+		throw exception::parse_error("multipart headers are too large");
+	} else if (position == std::string::npos) {
+		return size;
+	}
+
+	// the buffer starts with the line break of the boundary line
+	_state = STATE::body;
+
+	_part_handler(position >= 2 ? string_view(_headers.data() + 2, position - 2) : string_view());
+	_headers.clear();
+
+	return position + 4 - old_size;
+}
+
+void multipart::_emit(const char* data, std::size_t size)
+{
+	if (_state == STATE::body && size) {
+		_data_handler({ data, size });
+	}
+}
+
+void multipart::_delimiter_found()
+{
+	if (_state == STATE::body && _end_handler) {
+		_end_handler();
+	}
+
+	_state = STATE::boundary_line;
+}
+
+} // namespace fast_cgi
\ No newline at end of file
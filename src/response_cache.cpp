@@ -0,0 +1,320 @@
+#include "fast_cgi/log.hpp"
+#include "fast_cgi/response_cache.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace fast_cgi {
+
+namespace {
+
+std::string lower_header_block(const std::string& content)
+{
+	auto crlf = content.find("\r\n\r\n");
+	auto lf   = content.find("\n\n");
+	auto end  = std::min(std::min(crlf, lf), content.size());
+	auto copy = content.substr(0, end);
+
+	std::transform(copy.begin(), copy.end(), copy.begin(),
+	               [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+	return copy;
+}
+
+/** returns the value of the header in a lowercase header block or an empty string */
+std::string header_value(const std::string& header, const char* name)
+{
+	for (std::size_t line = 0; line < header.size();) {
+		auto end = std::min(header.find('\n', line), header.size());
+
+		if (header.compare(line, std::strlen(name), name) == 0) {
+			return header.substr(line + std::strlen(name), end - line - std::strlen(name));
+		}
+
+		line = end + 1;
+	}
+
+	return {};
+}
+
+/** returns the status code of a lowercase header block; a missing status means 200 */
+int status_code(const std::string& header)
+{
+	auto status = header_value(header, "status:");
+
+	return status.empty() ? 200 : std::atoi(status.c_str());
+}
+
+/** returns the CGI variable of a lowercase request header */
+std::string variable_of(const std::string& header)
+{
+	std::string variable = header == "content-type" || header == "content-length" ? "" : "HTTP_";
+
+	for (auto c : header) {
+		variable.push_back(c == '-' ? '_' : static_cast<char>(std::toupper(static_cast<unsigned char>(c))));
+	}
+
+	return variable;
+}
+
+/**
+  Checks whether every request header named by the `Vary` headers of a lowercase header block is covered by the key.
+  A `*` is never covered.
+ */
+template<typename Keyed>
+bool vary_covered(const std::string& header, Keyed keyed, bool encoding_keyed)
+{
+	for (std::size_t line = 0; line < header.size();) {
+		auto end = std::min(header.find('\n', line), header.size());
+
+		if (header.compare(line, 5, "vary:") == 0) {
+			for (auto begin = line + 5; begin < end;) {
+				auto next  = std::min(header.find(',', begin), end);
+				auto first = header.find_first_not_of(" \t", begin);
+				auto last  = header.find_last_not_of(" \t\r", next - 1);
+
+				if (first < next && last >= first && last != std::string::npos) {
+					auto name = header.substr(first, last - first + 1);
+
+					if (name == "*" || (!keyed(variable_of(name)) && !(encoding_keyed && name == "accept-encoding"))) {
+						return false;
+					}
+				}
+
+				begin = next + 1;
+			}
+		}
+
+		line = end + 1;
+	}
+
+	return true;
+}
+
+bool shareable(const std::string& content)
+{
+	auto header = lower_header_block(content);
+
+	if (header.find("set-cookie:") != std::string::npos) {
+		return false;
+	}
+
+	auto cache_control = header_value(header, "cache-control:");
+
+	return cache_control.find("no-store") == std::string::npos &&
+	       cache_control.find("no-cache") == std::string::npos && cache_control.find("private") == std::string::npos;
+}
+
+} // namespace
+
+response_cache::response_cache(std::vector<std::string> keys, std::chrono::milliseconds ttl,
+                               std::chrono::milliseconds stale, std::size_t max_size)
+    : _keys(std::move(keys)), _ttl(ttl), _stale(stale), _statistics()
+{
+	_max_size = max_size;
+}
+
+bool response_cache::cacheable(const detail::params& params)
+{
+	auto method = params.method();
+
+	return method == detail::params::METHOD::GET || method == detail::params::METHOD::HEAD;
+}
+
+bool response_cache::storable(const detail::params& params, const std::string& content, bool encoding_keyed) const
+{
+	auto header = lower_header_block(content);
+
+	// a location without a status redirects
+	if (header_value(header, "status:").empty() && !header_value(header, "location:").empty()) {
+		return false;
+	}
+
+	switch (status_code(header)) {
+	case 200:
+	case 203:
+	case 204:
+	case 300:
+	case 301:
+	case 308:
+	case 404:
+	case 405:
+	case 410:
+	case 414: break;
+	default: return false;
+	}
+
+	auto keyed = [this](const std::string& name) { return std::find(_keys.begin(), _keys.end(), name) != _keys.end(); };
+
+	// the response depends on request headers that are not part of the key
+	if (!vary_covered(header, keyed, encoding_keyed)) {
+		return false;
+	}
+
+	// credentials and cookies that are not part of the key may personalize the response
+
+	if ((params.has(detail::params::VARIABLE::http_authorization) && !keyed("HTTP_AUTHORIZATION")) ||
+	    (params.has(detail::params::VARIABLE::http_cookie) && !keyed("HTTP_COOKIE"))) {
+		auto cache_control = header_value(header, "cache-control:");
+
+		return cache_control.find("public") != std::string::npos ||
+		       cache_control.find("s-maxage") != std::string::npos;
+	}
+
+	return true;
+}
+
+bool response_cache::storable_decision(const std::string& content)
+{
+	auto code = status_code(lower_header_block(content));
+
+	// errors of the authorizer are no decisions
+	return code == 200 || code == 401 || code == 403;
+}
+
+std::string response_cache::make_key(const detail::params& params) const
+{
+	std::string key = params.get(detail::params::VARIABLE::request_method);
+
+	for (auto& name : _keys) {
+		key.push_back('\0');
+
+		// distinguish between missing and empty values
+		if (params.has(name)) {
+			auto value = params[name];
+
+			key.push_back('\1');
+			key.append(value.data(), value.size());
+		}
+	}
+
+	return key;
+}
+
+std::pair<response_cache::LOOKUP, std::shared_ptr<const response_cache::entry>>
+    response_cache::find(const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto result = _entries.find(key);
+
+	if (result == _entries.end()) {
+		++_statistics.misses;
+
+		return { LOOKUP::miss, nullptr };
+	}
+
+	auto now   = clock_type::now();
+	auto value = result->second.value;
+
+	if (now < value->expires) {
+		++_statistics.hits;
+
+		// mark as recently used
+		_order.splice(_order.end(), _order, result->second.position);
+
+		return { LOOKUP::hit, std::move(value) };
+	} else if (now < value->stale_until) {
+		++_statistics.stale_hits;
+
+		if (result->second.revalidating) {
+			return { LOOKUP::stale, std::move(value) };
+		}
+
+		result->second.revalidating = true;
+
+		return { LOOKUP::revalidate, std::move(value) };
+	}
+
+	// expired
+	++_statistics.misses;
+
+	if (!result->second.revalidating) {
+		_erase(result);
+	}
+
+	return { LOOKUP::miss, nullptr };
+}
+
+void response_cache::store(const std::string& key, std::string content, detail::quadruple_type app_status)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto size   = key.size() + content.size();
+	auto result = _entries.find(key);
+
+	if (result != _entries.end()) {
+		_erase(result);
+	}
+
+	if (size > _max_size || !shareable(content)) {
+		FAST_CGI_LOG(DEBUG, "response is not cacheable");
+
+		return;
+	}
+
+	// make space
+	while (!_order.empty() && _statistics.size + size > _max_size) {
+		_erase(_entries.find(_order.front()));
+
+		++_statistics.evictions;
+	}
+
+	auto now   = clock_type::now();
+	auto value = std::make_shared<entry>();
+
+	value->content     = std::move(content);
+	value->app_status  = app_status;
+	value->expires     = now + _ttl;
+	value->stale_until = now + _ttl + _stale;
+
+	_entries.insert({ key, node{ std::move(value), _order.insert(_order.end(), key), false } });
+
+	_statistics.size += size;
+	++_statistics.entries;
+	++_statistics.stores;
+}
+
+void response_cache::abandon(const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto result = _entries.find(key);
+
+	if (result != _entries.end()) {
+		result->second.revalidating = false;
+	}
+}
+
+void response_cache::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_entries.clear();
+	_order.clear();
+
+	_statistics.size    = 0;
+	_statistics.entries = 0;
+}
+
+response_cache::statistics response_cache::stats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	return _statistics;
+}
+
+std::size_t response_cache::max_size() const noexcept
+{
+	return _max_size;
+}
+
+void response_cache::_erase(std::unordered_map<std::string, node>::iterator entry)
+{
+	_statistics.size -= entry->first.size() + entry->second.value->content.size();
+	--_statistics.entries;
+
+	_order.erase(entry->second.position);
+	_entries.erase(entry);
+}
+
+} // namespace fast_cgi
\ No newline at end of file
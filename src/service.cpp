@@ -7,7 +7,34 @@ namespace fast_cgi {
 service::service(std::shared_ptr<connector> connector, std::shared_ptr<memory::allocator> allocator)
     : _connector(std::move(connector)), _allocator(std::move(allocator))
 {
-	_version = detail::VERSION::FCGI_VERSION_1;
+	_version                = detail::VERSION::FCGI_VERSION_1;
+	_compression_level      = 0;
+	_connection_buffer_size = io::input_manager::default_capacity;
+}
+
+void service::set_compression_level(int level) noexcept
+{
+	_compression_level = level;
+}
+
+void service::set_response_cache(std::shared_ptr<response_cache> cache) noexcept
+{
+	_response_cache = std::move(cache);
+}
+
+void service::set_authorizer_cache(std::shared_ptr<response_cache> cache) noexcept
+{
+	_authorizer_cache = std::move(cache);
+}
+
+void service::set_governor(std::shared_ptr<memory::governor> governor) noexcept
+{
+	_governor = std::move(governor);
+}
+
+void service::set_connection_buffer_size(std::size_t size) noexcept
+{
+	_connection_buffer_size = size;
 }
 
 void service::run()
@@ -29,8 +56,17 @@ void service::join()
 
 void service::_connection_thread(std::shared_ptr<connection> connection)
 {
-	auto output_manager = std::make_shared<io::output_manager>(connection, _allocator);
-	auto reader         = io::input_manager::launch_input_manager(connection, _allocator);
+	auto input_allocator  = _allocator;
+	auto output_allocator = _allocator;
+
+	if (_governor) {
+		input_allocator  = _governor->track(_allocator, memory::governor::CATEGORY::connection_input);
+		output_allocator = _governor->track(_allocator, memory::governor::CATEGORY::output);
+	}
+
+	auto output_manager = std::make_shared<io::output_manager>(connection, output_allocator);
+	auto reader         = io::input_manager::launch_input_manager(connection, input_allocator, _governor,
+	                                                              _connection_buffer_size);
 
 	try {
 		_input_handler(reader, output_manager);
@@ -43,7 +79,8 @@ void service::_connection_thread(std::shared_ptr<connection> connection)
 
 void service::_input_handler(std::shared_ptr<io::reader> reader, std::shared_ptr<io::output_manager> output_manager)
 {
-	detail::request_manager request_manager(_allocator, reader, _role_factories);
+	detail::request_manager request_manager(_allocator, reader, _role_factories, _compression_level,
+	                                        _response_cache, _authorizer_cache, _governor);
 
 	while (!request_manager.should_terminate_connection()) {
 		auto record = detail::record::read(*reader);
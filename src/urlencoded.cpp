@@ -0,0 +1,258 @@
+#include "fast_cgi/urlencoded.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#elif defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+namespace fast_cgi {
+
+namespace {
+
+constexpr std::size_t initial_size = 256;
+
+inline bool special(char c) noexcept
+{
+	return c == '&' || c == '=' || c == '%' || c == '+';
+}
+
+/**
+  Finds the first `&`, `=`, `%` or `+`. The kernels compare 32 or 16 bytes at once if the target supports AVX2 or
+  SSE2; the remainder is searched byte by byte.
+
+  @returns the position or *end*
+ */
+const char* find_special(const char* begin, const char* end) noexcept
+{
+#if defined(__AVX2__)
+	const auto ampersand = _mm256_set1_epi8('&');
+	const auto equals    = _mm256_set1_epi8('=');
+	const auto percent   = _mm256_set1_epi8('%');
+	const auto plus      = _mm256_set1_epi8('+');
+
+	for (; end - begin >= 32; begin += 32) {
+		auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+		auto mask  = _mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, ampersand), _mm256_cmpeq_epi8(chunk, equals)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, percent), _mm256_cmpeq_epi8(chunk, plus))));
+
+		if (mask) {
+			return begin + __builtin_ctz(static_cast<unsigned int>(mask));
+		}
+	}
+#elif defined(__SSE2__)
+	const auto ampersand = _mm_set1_epi8('&');
+	const auto equals    = _mm_set1_epi8('=');
+	const auto percent   = _mm_set1_epi8('%');
+	const auto plus      = _mm_set1_epi8('+');
+
+	for (; end - begin >= 16; begin += 16) {
+		auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+		auto mask =
+		    _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, ampersand), _mm_cmpeq_epi8(chunk, equals)),
+		                                   _mm_or_si128(_mm_cmpeq_epi8(chunk, percent), _mm_cmpeq_epi8(chunk, plus))));
+
+		if (mask) {
+			return begin + __builtin_ctz(static_cast<unsigned int>(mask));
+		}
+	}
+#endif
+
+	while (begin != end && !special(*begin)) {
+		++begin;
+	}
+
+	return begin;
+}
+
+inline int hex_value(char c) noexcept
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+/**
+  Decodes the escape sequence at *read* to *write*.
+
+  @returns the position after the sequence
+ */
+inline char* decode_escape(char* read, const char* end, char*& write) noexcept
+{
+	if (*read == '+') {
+		*write++ = ' ';
+
+		return read + 1;
+	} else if (end - read >= 3) {
+		auto high = hex_value(read[1]);
+		auto low  = hex_value(read[2]);
+
+		if (high >= 0 && low >= 0) {
+			*write++ = static_cast<char>(high << 4 | low);
+
+			return read + 3;
+		}
+	}
+
+	*write++ = *read;
+
+	return read + 1;
+}
+
+/**
+  Moves the unescaped bytes in front of the next special character to *write*.
+
+  @returns the position of the special character or *end*
+ */
+inline char* copy_plain(char* read, char* end, char*& write) noexcept
+{
+	auto position = read + (find_special(read, end) - read);
+
+	// nothing was decoded yet
+	if (write != read) {
+		std::memmove(write, read, position - read);
+	}
+
+	write += position - read;
+
+	return position;
+}
+
+} // namespace
+
+urlencoded::urlencoded(memory::arena* arena) : _data(arena), _pairs(arena)
+{}
+
+void urlencoded::parse(string_view content)
+{
+	_data.assign(content.begin(), content.end());
+	_parse();
+}
+
+void urlencoded::parse(std::istream& input)
+{
+	_data.clear();
+	_data.reserve(initial_size);
+
+	while (input) {
+		auto offset = _data.size();
+
+		if (offset == _data.capacity()) {
+			_data.reserve(offset * 2);
+		}
+
+		_data.resize(_data.capacity());
+		input.read(_data.data() + offset, static_cast<std::streamsize>(_data.size() - offset));
+		_data.resize(offset + static_cast<std::size_t>(input.gcount()));
+	}
+
+	_parse();
+}
+
+urlencoded::const_iterator urlencoded::begin() const noexcept
+{
+	return _pairs.begin();
+}
+
+urlencoded::const_iterator urlencoded::end() const noexcept
+{
+	return _pairs.end();
+}
+
+std::size_t urlencoded::size() const noexcept
+{
+	return _pairs.size();
+}
+
+bool urlencoded::has(string_view name) const noexcept
+{
+	return std::find_if(_pairs.begin(), _pairs.end(), [name](const value_type& pair) { return pair.first == name; }) !=
+	       _pairs.end();
+}
+
+string_view urlencoded::operator[](string_view name) const
+{
+	for (auto& pair : _pairs) {
+		if (pair.first == name) {
+			return pair.second;
+		}
+	}
+
+	throw std::out_of_range("form field does not exist");
+}
+
+std::size_t urlencoded::decode(char* data, std::size_t size) noexcept
+{
+	auto read  = data;
+	auto write = data;
+	auto end   = data + size;
+
+	while ((read = copy_plain(read, end, write)) != end) {
+		if (*read == '&' || *read == '=') {
+			*write++ = *read++;
+		} else {
+			read = decode_escape(read, end, write);
+		}
+	}
+
+	return static_cast<std::size_t>(write - data);
+}
+
+void urlencoded::_parse()
+{
+	_pairs.clear();
+
+	auto read        = _data.data();
+	auto write       = read;
+	auto end         = read + _data.size();
+	auto name        = write;
+	char* value      = nullptr;
+	auto finish_pair = [&] {
+		auto name_end = value ? value : write;
+
+		if (name_end != name || value) {
+			_pairs.push_back({ { name, static_cast<std::size_t>(name_end - name) },
+			                   { value ? value : write, static_cast<std::size_t>(value ? write - value : 0) } });
+		}
+	};
+
+	while ((read = copy_plain(read, end, write)) != end) {
+		switch (*read) {
+		case '&':
+			finish_pair();
+
+			name  = write;
+			value = nullptr;
+			++read;
+
+			break;
+		case '=':
+			// only the first separates the name from the value
+			if (value) {
+				*write++ = '=';
+			} else {
+				value = write;
+			}
+
+			++read;
+
+			break;
+		default: read = decode_escape(read, end, write); break;
+		}
+	}
+
+	finish_pair();
+}
+
+} // namespace fast_cgi
\ No newline at end of file
@@ -0,0 +1,301 @@
+#ifndef FAST_CGI_TEST_CLIENT_HPP_
+#define FAST_CGI_TEST_CLIENT_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <fast_cgi/connection.hpp>
+#include <fast_cgi/connector.hpp>
+#include <fast_cgi/service.hpp>
+#include <memory>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace fast_cgi {
+namespace test {
+
+/**
+  One end of a local socket pair.
+ */
+class socket_connection : public connection
+{
+public:
+	socket_connection(int socket) : connection(true), _socket(socket)
+	{}
+	~socket_connection()
+	{
+		::close(_socket);
+	}
+
+protected:
+	virtual void do_flush() override
+	{}
+	virtual size_type do_in_available() override
+	{
+		int count = 0;
+
+		ioctl(_socket, FIONREAD, &count);
+
+		return static_cast<size_type>(count);
+	}
+	virtual bool do_closed() override
+	{
+		char c;
+
+		return recv(_socket, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0;
+	}
+	virtual size_type do_read(void* buffer, size_type at_least, size_type at_most) override
+	{
+		auto read = recv(_socket, buffer, at_most, 0);
+
+		return read < 0 ? 0 : static_cast<size_type>(read);
+	}
+	virtual size_type do_write(const void* buffer, size_type size) override
+	{
+		size_type written = 0;
+
+		while (written < size) {
+			auto sent = send(_socket, static_cast<const char*>(buffer) + written, size - written, MSG_NOSIGNAL);
+
+			if (sent <= 0) {
+				break;
+			}
+
+			written += static_cast<size_type>(sent);
+		}
+
+		return written;
+	}
+
+private:
+	int _socket;
+};
+
+/**
+  Accepts a single socket pair connection.
+ */
+class socket_connector : public connector
+{
+public:
+	socket_connector(int socket) : _socket(socket)
+	{}
+	virtual void run(const acceptor_type& acceptor) override
+	{
+		acceptor(std::make_shared<socket_connection>(_socket));
+	}
+
+private:
+	int _socket;
+};
+
+struct response
+{
+	std::string output;
+	std::string error;
+	std::uint32_t app_status;
+	int protocol_status;
+	std::size_t records;
+	/** the payload sizes of the stdout records */
+	std::vector<std::size_t> output_records;
+};
+
+typedef std::vector<std::pair<std::string, std::string>> params_type;
+
+/**
+  A minimal web server side of a FastCGI connection. The service runs on its own thread until the connection is
+  closed.
+ */
+class client
+{
+public:
+	client(std::shared_ptr<memory::allocator> allocator) : _socket(-1)
+	{
+		int sockets[2];
+
+		socketpair(AF_UNIX, SOCK_STREAM, 0, sockets);
+
+		_socket  = sockets[1];
+		_service = std::unique_ptr<fast_cgi::service>(
+		    new fast_cgi::service(std::make_shared<socket_connector>(sockets[0]), std::move(allocator)));
+	}
+	~client()
+	{
+		close();
+	}
+	fast_cgi::service& service() noexcept
+	{
+		return *_service;
+	}
+	void start()
+	{
+		_thread = std::thread([this] {
+			_service->run();
+			_service->join();
+		});
+	}
+	/**
+	  Closes the connection and waits for the service.
+	 */
+	void close()
+	{
+		if (_socket != -1) {
+			shutdown(_socket, SHUT_WR);
+		}
+
+		if (_thread.joinable()) {
+			_thread.join();
+		}
+
+		if (_socket != -1) {
+			::close(_socket);
+
+			_socket = -1;
+		}
+	}
+	void send_request(int id, int role, bool keep, const params_type& params, const std::string& input = {},
+	                  const std::string* data = nullptr)
+	{
+		std::string request;
+		std::string begin(8, '\0');
+
+		begin[1] = static_cast<char>(role);
+		begin[2] = keep ? 1 : 0;
+
+		_record(request, 1, id, begin);
+
+		std::string encoded;
+
+		for (auto& param : params) {
+			_length(encoded, param.first.size());
+			_length(encoded, param.second.size());
+
+			encoded += param.first;
+			encoded += param.second;
+		}
+
+		if (!encoded.empty()) {
+			_record(request, 4, id, encoded);
+		}
+
+		_record(request, 4, id, {});
+
+		if (!input.empty()) {
+			_record(request, 5, id, input);
+		}
+
+		_record(request, 5, id, {});
+
+		if (data) {
+			if (!data->empty()) {
+				_record(request, 8, id, *data);
+			}
+
+			_record(request, 8, id, {});
+		}
+
+		send_raw(request);
+	}
+	void send_raw(const std::string& content)
+	{
+		for (std::size_t sent = 0; sent < content.size();) {
+			auto s = send(_socket, content.data() + sent, content.size() - sent, MSG_NOSIGNAL);
+
+			if (s <= 0) {
+				break;
+			}
+
+			sent += static_cast<std::size_t>(s);
+		}
+	}
+	/**
+	  Reads the records of the next request until its end.
+	 */
+	response read_response()
+	{
+		response r{ {}, {}, 0, -1, 0, {} };
+
+		while (true) {
+			unsigned char header[8];
+
+			if (!_receive(header, sizeof(header))) {
+				return r;
+			}
+
+			std::string body((header[4] << 8 | header[5]) + header[6], '\0');
+
+			_receive(&body[0], body.size());
+			body.resize(header[4] << 8 | header[5]);
+
+			++r.records;
+
+			if (header[1] == 6) {
+				r.output += body;
+				r.output_records.push_back(body.size());
+			} else if (header[1] == 7) {
+				r.error += body;
+			} else if (header[1] == 3) {
+				auto status = reinterpret_cast<const unsigned char*>(body.data());
+
+				r.app_status      = std::uint32_t(status[0]) << 24 | status[1] << 16 | status[2] << 8 | status[3];
+				r.protocol_status = status[4];
+
+				return r;
+			}
+		}
+	}
+
+private:
+	int _socket;
+	std::unique_ptr<fast_cgi::service> _service;
+	std::thread _thread;
+
+	static void _record(std::string& output, int type, int id, const std::string& body)
+	{
+		std::size_t offset = 0;
+
+		do {
+			auto size             = std::min<std::size_t>(body.size() - offset, 65535);
+			const char header[8] = { 1, static_cast<char>(type), static_cast<char>(id >> 8), static_cast<char>(id),
+				                     static_cast<char>(size >> 8), static_cast<char>(size), 0, 0 };
+
+			output.append(header, sizeof(header));
+			output.append(body, offset, size);
+
+			offset += size;
+		} while (offset < body.size());
+	}
+	static void _length(std::string& output, std::size_t length)
+	{
+		if (length < 128) {
+			output += static_cast<char>(length);
+		} else {
+			output += static_cast<char>(length >> 24 | 0x80);
+			output += static_cast<char>(length >> 16);
+			output += static_cast<char>(length >> 8);
+			output += static_cast<char>(length);
+		}
+	}
+	bool _receive(void* buffer, std::size_t size)
+	{
+		for (std::size_t received = 0; received < size;) {
+			auto r = recv(_socket, static_cast<char*>(buffer) + received, size - received, 0);
+
+			if (r <= 0) {
+				return false;
+			}
+
+			received += static_cast<std::size_t>(r);
+		}
+
+		return true;
+	}
+};
+
+} // namespace test
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef FAST_CGI_TEST_COUNTING_ALLOCATOR_HPP_
+#define FAST_CGI_TEST_COUNTING_ALLOCATOR_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <fast_cgi/memory/allocator.hpp>
+
+namespace fast_cgi {
+namespace test {
+
+/**
+  Forwards to `std::malloc()` and counts the allocations and the allocated bytes.
+ */
+class counting_allocator : public memory::allocator
+{
+public:
+	std::atomic<std::size_t> allocations{ 0 };
+	std::atomic<std::size_t> deallocations{ 0 };
+	std::atomic<std::size_t> used{ 0 };
+	std::atomic<std::size_t> peak{ 0 };
+
+	virtual void* allocate(std::size_t size, std::size_t align) override
+	{
+		auto now = used += size;
+		auto max = peak.load();
+
+		while (now > max && !peak.compare_exchange_weak(max, now)) {
+		}
+
+		++allocations;
+
+		return std::malloc(size);
+	}
+	virtual void deallocate(void* ptr, std::size_t size) override
+	{
+		used -= size;
+		++deallocations;
+
+		std::free(ptr);
+	}
+	std::size_t live() const noexcept
+	{
+		return allocations - deallocations;
+	}
+};
+
+} // namespace test
+} // namespace fast_cgi
+
+#endif
\ No newline at end of file
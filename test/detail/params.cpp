@@ -0,0 +1,325 @@
+#include "../client.hpp"
+#include "../counting_allocator.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstring>
+#include <fast_cgi/detail/params.hpp>
+#include <fast_cgi/role.hpp>
+#include <map>
+#include <memory>
+#include <string>
+
+using namespace fast_cgi;
+
+namespace {
+
+typedef detail::params::VARIABLE VARIABLE;
+
+const char* const variable_names[] = { "AUTH_TYPE",
+	                                   "CONTENT_LENGTH",
+	                                   "CONTENT_TYPE",
+	                                   "DOCUMENT_ROOT",
+	                                   "DOCUMENT_URI",
+	                                   "GATEWAY_INTERFACE",
+	                                   "HTTPS",
+	                                   "HTTP_ACCEPT",
+	                                   "HTTP_ACCEPT_ENCODING",
+	                                   "HTTP_ACCEPT_LANGUAGE",
+	                                   "HTTP_AUTHORIZATION",
+	                                   "HTTP_COOKIE",
+	                                   "HTTP_HOST",
+	                                   "HTTP_REFERER",
+	                                   "HTTP_USER_AGENT",
+	                                   "PATH_INFO",
+	                                   "PATH_TRANSLATED",
+	                                   "QUERY_STRING",
+	                                   "REMOTE_ADDR",
+	                                   "REMOTE_HOST",
+	                                   "REMOTE_PORT",
+	                                   "REMOTE_USER",
+	                                   "REQUEST_METHOD",
+	                                   "REQUEST_SCHEME",
+	                                   "REQUEST_URI",
+	                                   "SCRIPT_FILENAME",
+	                                   "SCRIPT_NAME",
+	                                   "SERVER_ADDR",
+	                                   "SERVER_NAME",
+	                                   "SERVER_PORT",
+	                                   "SERVER_PROTOCOL",
+	                                   "SERVER_SOFTWARE",
+	                                   "FCGI_DATA_LENGTH" };
+
+static_assert(sizeof(variable_names) / sizeof(*variable_names) == detail::params::variable_count,
+              "a variable is missing");
+
+std::unique_ptr<detail::params> captured;
+std::size_t captured_arena = 0;
+
+/** keeps a copy of the parameters */
+class capture : public responder
+{
+public:
+	virtual status_code_type run() override
+	{
+		captured.reset(new detail::params(params()));
+		captured_arena = arena().capacity();
+
+		return 0;
+	}
+};
+
+/**
+  Sends the parameters in one request and returns them as the role received them.
+ */
+detail::params receive(const test::params_type& params)
+{
+	test::client client(std::make_shared<test::counting_allocator>());
+
+	client.service().set_role<capture>();
+	client.start();
+	client.send_request(1, 1, false, params);
+
+	REQUIRE(client.read_response().protocol_status == 0);
+
+	client.close();
+
+	return std::move(*captured);
+}
+
+/** the parameters nginx sends for a typical request */
+test::params_type nginx_params()
+{
+	return { { "QUERY_STRING", "page=2&sort=name" },
+		     { "REQUEST_METHOD", "GET" },
+		     { "CONTENT_TYPE", "" },
+		     { "CONTENT_LENGTH", "" },
+		     { "SCRIPT_NAME", "/app" },
+		     { "REQUEST_URI", "/app/items?page=2&sort=name" },
+		     { "DOCUMENT_URI", "/app" },
+		     { "DOCUMENT_ROOT", "/var/www/html" },
+		     { "SERVER_PROTOCOL", "HTTP/1.1" },
+		     { "REQUEST_SCHEME", "https" },
+		     { "HTTPS", "on" },
+		     { "GATEWAY_INTERFACE", "CGI/1.1" },
+		     { "SERVER_SOFTWARE", "nginx/1.24.0" },
+		     { "REMOTE_ADDR", "203.0.113.7" },
+		     { "REMOTE_PORT", "52144" },
+		     { "SERVER_ADDR", "198.51.100.1" },
+		     { "SERVER_PORT", "443" },
+		     { "SERVER_NAME", "example.com" },
+		     { "REDIRECT_STATUS", "200" },
+		     { "SCRIPT_FILENAME", "/var/www/html/app" },
+		     { "HTTP_HOST", "example.com" },
+		     { "HTTP_USER_AGENT", "Mozilla/5.0 (X11; Linux x86_64; rv:120.0) Gecko/20100101 Firefox/120.0" },
+		     { "HTTP_ACCEPT", "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8" },
+		     { "HTTP_ACCEPT_LANGUAGE", "en-US,en;q=0.5" },
+		     { "HTTP_ACCEPT_ENCODING", "gzip, deflate, br" },
+		     { "HTTP_REFERER", "https://example.com/app/items" },
+		     { "HTTP_CONNECTION", "keep-alive" },
+		     { "HTTP_COOKIE", "session=0123456789abcdef; theme=dark; consent=1" },
+		     { "HTTP_UPGRADE_INSECURE_REQUESTS", "1" },
+		     { "HTTP_SEC_FETCH_DEST", "document" },
+		     { "HTTP_SEC_FETCH_MODE", "navigate" },
+		     { "HTTP_SEC_FETCH_SITE", "same-origin" } };
+}
+
+std::string str(string_view view)
+{
+	return { view.data(), view.size() };
+}
+
+} // namespace
+
+TEST_CASE("params fill the slots of the standard variables", "[params]")
+{
+	test::params_type sent;
+
+	for (auto name : variable_names) {
+		sent.emplace_back(name, std::string("value of ") + name);
+	}
+
+	sent.emplace_back("X_CUSTOM", "custom");
+
+	auto params = receive(sent);
+
+	CHECK(params.size() == sent.size());
+
+	for (std::size_t i = 0; i < detail::params::variable_count; ++i) {
+		auto variable = static_cast<VARIABLE>(i);
+
+		INFO(variable_names[i]);
+		CHECK(params.has(variable));
+		CHECK(str(params.get(variable)) == std::string("value of ") + variable_names[i]);
+		CHECK(str(params[variable_names[i]]) == std::string("value of ") + variable_names[i]);
+	}
+
+	CHECK(str(params["X_CUSTOM"]) == "custom");
+	CHECK_THROWS_AS(params["X_MISSING"], std::out_of_range);
+}
+
+TEST_CASE("params do not confuse similar names with standard variables", "[params]")
+{
+	test::params_type sent;
+
+	// names that share the length and some characters with a standard variable
+	for (auto name : variable_names) {
+		std::string similar(name);
+
+		similar[similar.size() / 2] = similar[similar.size() / 2] == 'X' ? 'Y' : 'X';
+
+		sent.emplace_back(similar, "similar");
+		sent.emplace_back(std::string(name) + "S", "longer");
+		sent.emplace_back(std::string(name, std::strlen(name) - 1) + "x", "last");
+	}
+
+	auto params = receive(sent);
+
+	for (std::size_t i = 0; i < detail::params::variable_count; ++i) {
+		INFO(variable_names[i]);
+		CHECK_FALSE(params.has(static_cast<VARIABLE>(i)));
+		CHECK(params.get(static_cast<VARIABLE>(i)).empty());
+		CHECK_FALSE(params.has(variable_names[i]));
+	}
+
+	CHECK(params.content_size() == 0);
+	CHECK(params.method() == detail::params::METHOD::UNKNOWN);
+}
+
+TEST_CASE("params parse the typed variables", "[params]")
+{
+	auto params = receive({ { "CONTENT_LENGTH", "1234" },
+	                        { "FCGI_DATA_LENGTH", "99" },
+	                        { "REQUEST_METHOD", "PATCH" },
+	                        { "EMPTY", "" } });
+
+	CHECK(params.content_size() == 1234);
+	CHECK(params.data_size() == 99);
+	CHECK(params.method() == detail::params::METHOD::PATCH);
+	CHECK(params.has("EMPTY"));
+	CHECK(params["EMPTY"].empty());
+
+	CHECK(receive({ { "CONTENT_LENGTH", "12a" } }).content_size() == 0);
+	CHECK(receive({ { "REQUEST_METHOD", "get" } }).method() == detail::params::METHOD::UNKNOWN);
+}
+
+TEST_CASE("params look up request headers", "[params]")
+{
+	auto params = receive({ { "HTTP_USER_AGENT", "agent" },
+	                        { "HTTP_X_FORWARDED_FOR", "10.0.0.1" },
+	                        { "HTTP_X_CUSTOM_HEADER_WITH_A_LONG_NAME", "long" },
+	                        { "CONTENT_TYPE", "text/plain" },
+	                        { "CONTENT_LENGTH", "5" },
+	                        { "REMOTE_ADDR", "127.0.0.1" } });
+
+	CHECK(str(params.header("user-agent")) == "agent");
+	CHECK(str(params.header("User-Agent")) == "agent");
+	CHECK(str(params.header("USER_AGENT")) == "agent");
+	CHECK(str(params.header("x-forwarded-for")) == "10.0.0.1");
+	CHECK(str(params.header("X-Custom-Header-With-A-Long-Name")) == "long");
+	CHECK(str(params.header("content-type")) == "text/plain");
+	CHECK(str(params.header("Content-Length")) == "5");
+	CHECK(params.has_header("user-agent"));
+	CHECK_FALSE(params.has_header("remote-addr"));
+	CHECK_FALSE(params.has_header("user-agen"));
+	CHECK(params.header("accept").empty());
+
+	// many headers grow the table
+	test::params_type sent;
+
+	for (int i = 0; i < 200; ++i) {
+		sent.emplace_back("HTTP_X_HEADER_" + std::to_string(i), std::to_string(i));
+	}
+
+	params = receive(sent);
+
+	for (int i = 0; i < 200; ++i) {
+		REQUIRE(str(params.header("x-header-" + std::to_string(i))) == std::to_string(i));
+	}
+}
+
+TEST_CASE("params split the cookies", "[params]")
+{
+	auto params = receive({ { "HTTP_COOKIE", "a=1; b=\"two\";c=3 ; a=4; empty=; flag" } });
+
+	CHECK(str(params.cookie("a")) == "1");
+	CHECK(str(params.cookie("b")) == "two");
+	CHECK(str(params.cookie("c")) == "3");
+	CHECK(params.has_cookie("empty"));
+	CHECK(params.cookie("empty").empty());
+	CHECK_FALSE(params.has_cookie("A"));
+	CHECK_FALSE(params.has_cookie("d"));
+
+	CHECK_FALSE(receive({}).has_cookie("a"));
+}
+
+TEST_CASE("params are read into a block of the stream size", "[params]")
+{
+	// the stream spans several records but stays below the maximum buffer size
+	auto params = receive({ { "HTTP_COOKIE", std::string(60000, 'c') }, { "X_LARGE", std::string(30000, 'x') } });
+
+	CHECK(params.header("cookie").size() == 60000);
+	CHECK(params["X_LARGE"].size() == 30000);
+
+	// the block did not grow by doubling
+	CHECK(captured_arena < 200000);
+}
+
+TEST_CASE("params decode and lookup", "[params][!benchmark]")
+{
+	test::client client(std::make_shared<test::counting_allocator>());
+	auto sent = nginx_params();
+
+	client.service().set_role<capture>();
+	client.start();
+
+	// the decoding is measured as part of a whole request
+	BENCHMARK("a request without parameters")
+	{
+		client.send_request(1, 1, true, {});
+
+		return client.read_response().records;
+	};
+
+	BENCHMARK("a request with the parameters of nginx")
+	{
+		client.send_request(1, 1, true, sent);
+
+		return client.read_response().records;
+	};
+
+	client.close();
+
+	auto& params = *captured;
+	auto map     = params.to_map();
+
+	BENCHMARK("looking up standard variables")
+	{
+		return params.get(VARIABLE::request_uri).size() + params.get(VARIABLE::http_host).size() +
+		       params.get(VARIABLE::query_string).size();
+	};
+
+	BENCHMARK("looking up standard variables by name")
+	{
+		return params["REQUEST_URI"].size() + params["HTTP_HOST"].size() + params["QUERY_STRING"].size();
+	};
+
+	BENCHMARK("looking up standard variables in a std::map")
+	{
+		return map["REQUEST_URI"].size() + map["HTTP_HOST"].size() + map["QUERY_STRING"].size();
+	};
+
+	BENCHMARK("looking up other variables by name")
+	{
+		return params["REDIRECT_STATUS"].size() + params["HTTP_SEC_FETCH_MODE"].size();
+	};
+
+	BENCHMARK("looking up other variables in a std::map")
+	{
+		return map["REDIRECT_STATUS"].size() + map["HTTP_SEC_FETCH_MODE"].size();
+	};
+
+	BENCHMARK("looking up headers and cookies")
+	{
+		return params.header("sec-fetch-mode").size() + params.cookie("theme").size();
+	};
+}
\ No newline at end of file
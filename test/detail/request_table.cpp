@@ -0,0 +1,155 @@
+#include "../counting_allocator.hpp"
+
+#include <catch2/catch.hpp>
+#include <fast_cgi/detail/request_table.hpp>
+#include <map>
+#include <memory>
+#include <random>
+
+using namespace fast_cgi;
+
+namespace {
+
+typedef detail::request_table::value_type value_type;
+
+value_type make_request(detail::double_type id)
+{
+	auto allocator = std::make_shared<test::counting_allocator>();
+	auto request   = std::make_shared<detail::request>(allocator, allocator);
+
+	request->id = id;
+
+	return request;
+}
+
+/** checks that the table holds exactly the requests of the reference */
+void check(const detail::request_table& table, const std::map<detail::double_type, value_type>& reference)
+{
+	std::size_t count = 0;
+
+	REQUIRE(table.size() == reference.size());
+
+	for (auto& entry : reference) {
+		INFO(entry.first);
+		REQUIRE(table.find(entry.first) == entry.second);
+	}
+
+	table.for_each([&](const value_type& request) {
+		REQUIRE(reference.at(request->id) == request);
+
+		++count;
+	});
+
+	REQUIRE(count == reference.size());
+}
+
+} // namespace
+
+TEST_CASE("request_table finds colliding ids", "[request_table]")
+{
+	detail::request_table table;
+	std::map<detail::double_type, value_type> reference;
+
+	// ids that differ by the initial size share their home slot
+	for (detail::double_type id : { 3, 11, 19 }) {
+		reference[id] = make_request(id);
+		table.insert(id, reference[id]);
+	}
+
+	check(table, reference);
+	CHECK_FALSE(table.find(27));
+
+	// an existing id is replaced
+	reference[11] = make_request(11);
+	table.insert(11, reference[11]);
+
+	check(table, reference);
+
+	// only the given request is removed
+	CHECK_FALSE(table.erase(11, make_request(11).get()));
+	CHECK_FALSE(table.erase(27, nullptr));
+	CHECK(table.erase(3, reference[3].get()));
+
+	reference.erase(3);
+
+	check(table, reference);
+}
+
+TEST_CASE("request_table shifts entries back across the end of the slots", "[request_table]")
+{
+	detail::request_table table;
+	std::map<detail::double_type, value_type> reference;
+
+	// the home of these ids is the last slot, so the cluster wraps around to the first slots
+	for (detail::double_type id : { 1, 9, 17, 2 }) {
+		reference[id] = make_request(id);
+		table.insert(id, reference[id]);
+	}
+
+	check(table, reference);
+
+	SECTION("the first entry of the cluster")
+	{
+		CHECK(table.erase(1, reference[1].get()));
+
+		reference.erase(1);
+
+		check(table, reference);
+	}
+
+	SECTION("an entry after the end")
+	{
+		CHECK(table.erase(9, reference[9].get()));
+
+		reference.erase(9);
+
+		check(table, reference);
+	}
+
+	// the slots are free again
+	for (auto& entry : reference) {
+		CHECK(table.erase(entry.first, entry.second.get()));
+	}
+
+	CHECK(table.empty());
+	CHECK_FALSE(table.find(17));
+}
+
+TEST_CASE("request_table grows and behaves like a map", "[request_table]")
+{
+	detail::request_table table;
+	std::map<detail::double_type, value_type> reference;
+	std::mt19937 random(4);
+
+	// many requests grow the table
+	for (detail::double_type id = 1; id <= 100; ++id) {
+		reference[id] = make_request(id);
+		table.insert(id, reference[id]);
+	}
+
+	check(table, reference);
+
+	// random operations on clustered ids
+	for (int i = 0; i < 20000; ++i) {
+		auto id = static_cast<detail::double_type>(random() % 64 * 8 + random() % 2);
+
+		if (random() % 2) {
+			reference[id] = make_request(id);
+			table.insert(id, reference[id]);
+		} else {
+			auto it = reference.find(id);
+
+			CHECK(table.erase(id, it == reference.end() ? nullptr : it->second.get()) == (it != reference.end()));
+
+			if (it != reference.end()) {
+				reference.erase(it);
+			}
+		}
+
+		if (i % 100 == 0) {
+			check(table, reference);
+		}
+	}
+
+	check(table, reference);
+}
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include <catch2/catch.hpp>
+#include <cstring>
+#include <fast_cgi/io/byte_stream.hpp>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace fast_cgi;
+
+namespace {
+
+/** hands out pages that double in size up to a maximum and collects the written pages */
+struct pages
+{
+	std::vector<std::unique_ptr<char[]>> allocated;
+	std::vector<std::string> written;
+	std::vector<std::string> adopted;
+	std::size_t size;
+	std::size_t max_size;
+	std::size_t empty = 0;
+
+	pages(std::size_t size, std::size_t max_size) : size(size), max_size(max_size)
+	{}
+	io::output_streambuf::writer_type writer()
+	{
+		return [this](void* buffer, std::size_t length) -> std::pair<void*, std::size_t> {
+			if (buffer && length) {
+				written.emplace_back(static_cast<char*>(buffer), length);
+			} else if (buffer) {
+				++empty;
+			}
+
+			auto page = size;
+
+			size = std::min(size * 2, max_size);
+
+			allocated.emplace_back(new char[page]);
+
+			return { allocated.back().get(), page };
+		};
+	}
+	io::output_streambuf::adopter_type adopter()
+	{
+		return [this](const void* data, std::size_t length, std::shared_ptr<const void> /* owner */) {
+			written.emplace_back(static_cast<const char*>(data), length);
+			adopted.emplace_back(static_cast<const char*>(data), length);
+		};
+	}
+	std::string output() const
+	{
+		std::string all;
+
+		for (auto& page : written) {
+			all += page;
+		}
+
+		return all;
+	}
+};
+
+} // namespace
+
+TEST_CASE("output_streambuf reserves regions in its pages", "[byte_stream]")
+{
+	pages p(16, 64);
+	io::output_streambuf buffer(p.writer());
+
+	auto region = buffer.reserve(10);
+
+	REQUIRE(region);
+	std::memcpy(region, "0123456789", 10);
+
+	// only the committed part is written
+	buffer.commit(4);
+	buffer.sputn("abcdefghij", 10);
+
+	SECTION("a full page is handed out")
+	{
+		region = buffer.reserve(8);
+
+		REQUIRE(region);
+		std::memcpy(region, "ABCDEFGH", 8);
+		buffer.commit(8);
+		buffer.flush();
+
+		CHECK(p.written == std::vector<std::string>{ "0123abcdefghij", "ABCDEFGH" });
+		CHECK(p.empty == 0);
+	}
+
+	SECTION("an empty page is exchanged for a larger one")
+	{
+		buffer.flush();
+
+		// the next page has 32 bytes
+		CHECK(buffer.reserve(48));
+		CHECK(p.empty == 1);
+
+		buffer.commit(0);
+
+		// the pages do not grow beyond 64 bytes
+		CHECK_FALSE(buffer.reserve(65));
+		CHECK(buffer.reserve(64));
+
+		buffer.flush();
+
+		CHECK(p.output() == "0123abcdefghij");
+	}
+}
+
+TEST_CASE("output_streambuf writes buffers in order", "[byte_stream]")
+{
+	pages p(8, 8);
+	io::output_streambuf buffer(p.writer());
+	std::string large(100, 'x');
+
+	CHECK(buffer.write({ { "Content-Type: ", 14 }, { "text/plain", 10 }, { "\r\n\r\n", 4 } }) == 28);
+	CHECK(buffer.write({ { large.data(), large.size() }, { "", 0 } }) == 100);
+
+	buffer.flush();
+
+	CHECK(p.output() == "Content-Type: text/plain\r\n\r\n" + large);
+
+	// every page is full except for the last one
+	for (std::size_t i = 0; i + 1 < p.written.size(); ++i) {
+		CHECK(p.written[i].size() == 8);
+	}
+}
+
+TEST_CASE("output_streambuf adopts buffers without copying them", "[byte_stream]")
+{
+	pages p(64, 64);
+	io::output_streambuf buffer(p.writer());
+	std::ostream output(&buffer);
+
+	SECTION("with an adopter")
+	{
+		buffer.set_adopter(p.adopter());
+
+		output << "header ";
+		buffer.adopt(std::string("adopted"));
+		buffer.adopt(std::make_shared<std::vector<char>>(3, 'v'));
+		buffer.adopt(nullptr, 0, nullptr);
+		output << " trailer";
+		buffer.flush();
+
+		// the pending page is handed out before the adopted buffer
+		CHECK(p.written == std::vector<std::string>{ "header ", "adopted", "vvv", " trailer" });
+		CHECK(p.adopted == std::vector<std::string>{ "adopted", "vvv" });
+	}
+
+	SECTION("without an adopter")
+	{
+		output << "header ";
+		buffer.adopt(std::string("copied"));
+		buffer.flush();
+
+		CHECK(p.written == std::vector<std::string>{ "header copied" });
+	}
+}
\ No newline at end of file
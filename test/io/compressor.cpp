@@ -0,0 +1,239 @@
+#include "../counting_allocator.hpp"
+
+#include <catch2/catch.hpp>
+#include <fast_cgi/exception/io_error.hpp>
+#include <fast_cgi/io/compressor.hpp>
+#include <random>
+#include <string>
+
+#if defined(FAST_CGI_ENABLE_COMPRESSION)
+#	include <zlib.h>
+#endif
+
+using namespace fast_cgi;
+
+typedef io::compressor::encoding encoding;
+
+#if defined(FAST_CGI_ENABLE_COMPRESSION)
+
+namespace {
+
+/** collects the pages handed to the sink */
+struct collector
+{
+	memory::buffer_manager pages;
+	std::string output;
+	std::size_t page_count = 0;
+	io::compressor compressor;
+
+	collector(encoding content_encoding)
+	    : pages(1024, std::make_shared<test::counting_allocator>()),
+	      compressor(content_encoding, 6, pages, [this](void* page, std::size_t size) {
+		      output.append(static_cast<const char*>(page), size);
+		      ++page_count;
+		      pages.free_page(page);
+	      })
+	{}
+	/** writes the response in chunks of the given size and finishes it */
+	std::string compress(const std::string& response, std::size_t chunk_size)
+	{
+		for (std::size_t offset = 0; offset < response.size(); offset += chunk_size) {
+			compressor.write(response.data() + offset, std::min(chunk_size, response.size() - offset));
+		}
+
+		compressor.finish();
+
+		return output;
+	}
+};
+
+std::string inflate(const std::string& data, encoding content_encoding)
+{
+	z_stream z{};
+	std::string output;
+	char buffer[4096];
+
+	REQUIRE(inflateInit2(&z, content_encoding == encoding::gzip ? 15 + 16 : 15) == Z_OK);
+
+	z.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+	z.avail_in = static_cast<uInt>(data.size());
+
+	auto result = Z_OK;
+
+	while (result == Z_OK) {
+		z.next_out  = reinterpret_cast<Bytef*>(buffer);
+		z.avail_out = sizeof(buffer);
+		result      = ::inflate(&z, Z_NO_FLUSH);
+
+		output.append(buffer, sizeof(buffer) - z.avail_out);
+	}
+
+	inflateEnd(&z);
+
+	CHECK(result == Z_STREAM_END);
+	CHECK(z.avail_in == 0);
+
+	return output;
+}
+
+std::string header_of(const std::string& response)
+{
+	return response.substr(0, response.find("\r\n\r\n") + 4);
+}
+
+std::string body_of(const std::string& response)
+{
+	return response.substr(response.find("\r\n\r\n") + 4);
+}
+
+} // namespace
+
+TEST_CASE("compressor negotiates the encoding", "[compressor]")
+{
+	CHECK(io::compressor::negotiate("") == encoding::identity);
+	CHECK(io::compressor::negotiate("identity") == encoding::identity);
+	CHECK(io::compressor::negotiate("br") == encoding::identity);
+	CHECK(io::compressor::negotiate("gzip") == encoding::gzip);
+	CHECK(io::compressor::negotiate("x-gzip") == encoding::gzip);
+	CHECK(io::compressor::negotiate(" GZip ;q=0.5") == encoding::gzip);
+	CHECK(io::compressor::negotiate("deflate") == encoding::deflate);
+	CHECK(io::compressor::negotiate("deflate, gzip") == encoding::gzip);
+	CHECK(io::compressor::negotiate("br, deflate;q=0.1") == encoding::deflate);
+
+	// a quality of zero refuses the coding
+	CHECK(io::compressor::negotiate("gzip;q=0") == encoding::identity);
+	CHECK(io::compressor::negotiate("gzip;q=0, deflate") == encoding::deflate);
+	CHECK(io::compressor::negotiate("deflate;q=0.0") == encoding::identity);
+	CHECK(io::compressor::negotiate("identity;q=0, gzip") == encoding::gzip);
+	CHECK(io::compressor::negotiate("identity;q=0") == encoding::identity);
+
+	// the wildcard selects gzip unless it was refused
+	CHECK(io::compressor::negotiate("*") == encoding::gzip);
+	CHECK(io::compressor::negotiate("*;q=0") == encoding::identity);
+	CHECK(io::compressor::negotiate("gzip;q=0, *") == encoding::identity);
+	CHECK(io::compressor::negotiate("gzip;q=0, deflate, *") == encoding::deflate);
+}
+
+TEST_CASE("compressor rewrites the header block", "[compressor]")
+{
+	std::string body(10000, 'x');
+	std::string response = "Content-Type: text/plain\r\nContent-Length: 10000\r\nX-Other: 1\r\n\r\n" + body;
+
+	for (auto content_encoding : { encoding::gzip, encoding::deflate }) {
+		for (std::size_t chunk_size : { std::size_t(1), std::size_t(7), std::size_t(4096), response.size() }) {
+			collector c(content_encoding);
+			auto output = c.compress(response, chunk_size);
+
+			INFO(chunk_size);
+			CHECK(header_of(output) ==
+			      std::string("Content-Type: text/plain\r\nX-Other: 1\r\nContent-Encoding: ") +
+			          (content_encoding == encoding::gzip ? "gzip" : "deflate") + "\r\nVary: Accept-Encoding\r\n\r\n");
+			CHECK(inflate(body_of(output), content_encoding) == body);
+			CHECK(output.size() < response.size());
+		}
+	}
+
+	SECTION("lines ending with a line feed")
+	{
+		collector c(encoding::gzip);
+		auto output = c.compress("Content-Type: text/plain\ncontent-length: 3\n\nabc", 5);
+
+		CHECK(output.compare(0, 26, "Content-Type: text/plain\nC") == 0);
+		CHECK(output.find("content-length") == std::string::npos);
+		CHECK(inflate(output.substr(output.find("\n\n") + 2), encoding::gzip) == "abc");
+	}
+}
+
+TEST_CASE("compressor passes some responses through", "[compressor]")
+{
+	const std::string responses[] = {
+		// already encoded
+		"Content-Type: text/plain\r\ncontent-encoding: br\r\n\r\n" + std::string(1000, 'b'),
+		// no body allowed
+		"Status: 304 Not Modified\r\n\r\n",
+		"Status: 204\r\n\r\n",
+		// an empty body
+		"Content-Type: text/plain\r\n\r\n",
+		// no complete header block
+		"Content-Type: text/plain\r\n",
+		"",
+	};
+
+	for (auto& response : responses) {
+		for (std::size_t chunk_size : { std::size_t(1), std::size_t(3), std::size_t(1) << 20 }) {
+			collector c(encoding::gzip);
+
+			INFO(response << " " << chunk_size);
+			CHECK(c.compress(response, chunk_size) == response);
+		}
+	}
+
+	SECTION("an oversized header block")
+	{
+		collector c(encoding::gzip);
+		auto response = "X-Long: " + std::string(20000, 'h') + "\r\n\r\nbody";
+
+		CHECK(c.compress(response, 1000) == response);
+	}
+
+	SECTION("a small body is compressed as well")
+	{
+		collector c(encoding::deflate);
+		auto output = c.compress("Content-Type: text/plain\r\n\r\na", 100);
+
+		CHECK(header_of(output).find("Content-Encoding: deflate") != std::string::npos);
+		CHECK(inflate(body_of(output), encoding::deflate) == "a");
+	}
+}
+
+TEST_CASE("compressor output inflates to the input", "[compressor]")
+{
+	std::mt19937 random(9);
+	std::string body;
+
+	// compressible text with some noise that spans many pages
+	while (body.size() < (1 << 20)) {
+		body += random() % 8 ? "lorem ipsum dolor sit amet " : std::to_string(random());
+	}
+
+	for (auto content_encoding : { encoding::gzip, encoding::deflate }) {
+		collector c(content_encoding);
+
+		c.compressor.write("Content-Type: text/plain\r\n\r\n", 28);
+
+		for (std::size_t offset = 0; offset < body.size();) {
+			auto size = std::min<std::size_t>(1 + random() % 10000, body.size() - offset);
+
+			c.compressor.write(body.data() + offset, size);
+
+			offset += size;
+
+			// a flush hands out everything written so far
+			if (random() % 50 == 0) {
+				auto count = c.page_count;
+
+				c.compressor.flush();
+
+				CHECK(c.page_count > count);
+			}
+		}
+
+		c.compressor.finish();
+		c.compressor.finish();
+
+		CHECK(inflate(body_of(c.output), content_encoding) == body);
+		CHECK(c.page_count > 1);
+	}
+}
+
+#else
+
+TEST_CASE("compressor only offers the identity without zlib", "[compressor]")
+{
+	memory::buffer_manager pages(1024, std::make_shared<test::counting_allocator>());
+
+	CHECK(io::compressor::negotiate("gzip, deflate") == encoding::identity);
+	CHECK_THROWS_AS(io::compressor(encoding::gzip, 6, pages, [](void*, std::size_t) {}), exception::io_error);
+}
+
+#endif
\ No newline at end of file
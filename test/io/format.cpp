@@ -0,0 +1,218 @@
+#include <catch2/catch.hpp>
+#include <climits>
+#include <fast_cgi/io/format.hpp>
+#include <limits>
+#include <sstream>
+#include <string>
+
+using namespace fast_cgi;
+
+namespace {
+
+/** collects the output of a stream buffer with small pages */
+struct collector
+{
+	std::string output;
+	char page[16];
+	io::output_streambuf buffer;
+
+	collector()
+	    : buffer([this](void* data, std::size_t size) -> std::pair<void*, std::size_t> {
+		      if (data) {
+			      output.append(static_cast<const char*>(data), size);
+		      }
+
+		      return { page, sizeof(page) };
+	      })
+	{}
+	std::string str()
+	{
+		buffer.flush();
+
+		return output;
+	}
+};
+
+template<typename... Args>
+std::string format(const char* format, const Args&... args)
+{
+	collector c;
+
+	io::format(c.buffer, format, args...);
+
+	return c.str();
+}
+
+/** counts the output of a stream buffer with pages like the ones of the roles */
+struct sink
+{
+	std::size_t written = 0;
+	char page[4096];
+	io::output_streambuf buffer;
+
+	sink()
+	    : buffer([this](void* data, std::size_t size) -> std::pair<void*, std::size_t> {
+		      if (data) {
+			      written += size;
+		      }
+
+		      return { page, sizeof(page) };
+	      })
+	{}
+};
+
+template<typename T>
+std::string number(T value)
+{
+	char output[io::max_number_size];
+
+	return { output, io::format_number(output, value) };
+}
+
+template<typename T>
+std::string stream(T value)
+{
+	std::ostringstream s;
+
+	s << value;
+
+	return s.str();
+}
+
+} // namespace
+
+TEST_CASE("vformat replaces placeholders", "[format]")
+{
+	CHECK(format("") == "");
+	CHECK(format("no placeholders") == "no placeholders");
+	CHECK(format("{}", 1) == "1");
+	CHECK(format("a{}b{}c", "x", 'y') == "axbyc");
+	CHECK(format("{}{}{}", std::string("s"), string_view("v"), -3) == "sv-3");
+	CHECK(format("{{\"id\":{}}}", 5) == "{\"id\":5}");
+	// longer than a page
+	CHECK(format("{} {}", std::string(40, 'x'), std::string(40, 'y')) ==
+	      std::string(40, 'x') + " " + std::string(40, 'y'));
+}
+
+TEST_CASE("vformat escapes braces", "[format]")
+{
+	CHECK(format("{{") == "{");
+	CHECK(format("}}") == "}");
+	CHECK(format("{{}}") == "{}");
+	CHECK(format("{{{}}}", 1) == "{1}");
+	CHECK(format("a{{b}}c") == "a{b}c");
+}
+
+TEST_CASE("vformat rejects invalid format strings", "[format]")
+{
+	CHECK_THROWS_AS(format("{}"), exception::format_error);
+	CHECK_THROWS_AS(format("{} {}", 1), exception::format_error);
+	CHECK_THROWS_AS(format("{"), exception::format_error);
+	CHECK_THROWS_AS(format("}"), exception::format_error);
+	CHECK_THROWS_AS(format("{x}", 1), exception::format_error);
+	CHECK_THROWS_AS(format("a}b"), exception::format_error);
+	CHECK_THROWS_AS(format("{\"id\":{}}", 5), exception::format_error);
+}
+
+TEST_CASE("format_number prints integers like operator<<", "[format]")
+{
+	CHECK(number(0ll) == "0");
+	CHECK(number(-1ll) == "-1");
+	CHECK(number(9ll) == "9");
+	CHECK(number(10ll) == "10");
+	CHECK(number(LLONG_MIN) == stream(LLONG_MIN));
+	CHECK(number(LLONG_MAX) == stream(LLONG_MAX));
+	CHECK(number(0ull) == "0");
+	CHECK(number(ULLONG_MAX) == stream(ULLONG_MAX));
+	CHECK(number(ULLONG_MAX) == "18446744073709551615");
+
+	for (unsigned long long i = 1; i < ULLONG_MAX / 10; i *= 10) {
+		CHECK(number(i) == stream(i));
+		CHECK(number(i - 1) == stream(i - 1));
+	}
+}
+
+TEST_CASE("format_number prints doubles like operator<<", "[format]")
+{
+	const double values[] = { 0.0,
+		                      -0.0,
+		                      1.0,
+		                      -1.5,
+		                      0.1,
+		                      3.14159265358979,
+		                      999999.0,
+		                      1e6,
+		                      1234567.0,
+		                      1e-5,
+		                      1e300,
+		                      -2.5e-300,
+		                      std::numeric_limits<double>::max(),
+		                      std::numeric_limits<double>::min(),
+		                      std::numeric_limits<double>::denorm_min(),
+		                      std::numeric_limits<double>::infinity(),
+		                      -std::numeric_limits<double>::infinity() };
+
+	for (auto value : values) {
+		CHECK(number(value) == stream(value));
+	}
+
+	CHECK(format("{}", 0.5f) == "0.5");
+}
+
+TEST_CASE("format is faster than operator<<", "[format][!benchmark]")
+{
+	const std::string name = "item";
+	sink s;
+	io::byte_ostream output(&s.buffer);
+
+	BENCHMARK("a JSON array with operator<<")
+	{
+		output << '[';
+
+		for (int i = 0; i < 1000; ++i) {
+			output << "{\"id\":" << i << ",\"name\":\"" << name << "\",\"price\":" << i * 0.25
+			       << ",\"stock\":" << 1000000 - i << "},";
+		}
+
+		output << "]" << std::flush;
+
+		return s.written;
+	};
+
+	BENCHMARK("a JSON array with format")
+	{
+		io::format(s.buffer, "[");
+
+		for (int i = 0; i < 1000; ++i) {
+			io::format(s.buffer, "{{\"id\":{},\"name\":\"{}\",\"price\":{},\"stock\":{}}},", i, name, i * 0.25,
+			           1000000 - i);
+		}
+
+		io::format(s.buffer, "]");
+		s.buffer.flush();
+
+		return s.written;
+	};
+
+	BENCHMARK("an HTML table with operator<<")
+	{
+		for (int i = 0; i < 1000; ++i) {
+			output << "<tr><td>" << i << "</td><td>" << name << "</td><td>" << i * 1.5 << "</td></tr>\n";
+		}
+
+		output << std::flush;
+
+		return s.written;
+	};
+
+	BENCHMARK("an HTML table with format")
+	{
+		for (int i = 0; i < 1000; ++i) {
+			io::format(s.buffer, "<tr><td>{}</td><td>{}</td><td>{}</td></tr>\n", i, name, i * 1.5);
+		}
+
+		s.buffer.flush();
+
+		return s.written;
+	};
+}
\ No newline at end of file
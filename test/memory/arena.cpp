@@ -0,0 +1,86 @@
+#include "../counting_allocator.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <fast_cgi/memory/arena.hpp>
+#include <memory>
+#include <vector>
+
+using namespace fast_cgi;
+
+TEST_CASE("arena aligns its allocations", "[arena]")
+{
+	memory::arena arena(std::make_shared<test::counting_allocator>(), 256);
+
+	for (std::size_t align = 1; align <= 64; align *= 2) {
+		for (std::size_t size = 1; size < 300; size += 37) {
+			auto ptr = arena.allocate(size, align);
+
+			INFO(size << " " << align);
+			REQUIRE(reinterpret_cast<std::uintptr_t>(ptr) % align == 0);
+		}
+	}
+}
+
+TEST_CASE("arena keeps one chunk of bounded size on reset", "[arena]")
+{
+	auto counting = std::make_shared<test::counting_allocator>();
+	memory::arena arena(counting, 1024, 4096);
+
+	for (int i = 0; i < 10; ++i) {
+		arena.allocate(512, 8);
+	}
+
+	arena.reset();
+
+	CHECK(arena.capacity() == 1024);
+	CHECK(counting->used == 1024);
+
+	// the chunk is reused
+	arena.allocate(512, 8);
+
+	CHECK(counting->used == 1024);
+
+	SECTION("a large chunk is released")
+	{
+		arena.allocate(100000, 8);
+		arena.reset();
+
+		CHECK(arena.capacity() == 1024);
+		CHECK(counting->used == 1024);
+	}
+
+	SECTION("only a large chunk")
+	{
+		arena.release();
+		arena.allocate(100000, 8);
+		arena.reset();
+
+		CHECK(arena.capacity() == 0);
+		CHECK(counting->used == 0);
+	}
+
+	arena.release();
+
+	CHECK(counting->used == 0);
+}
+
+TEST_CASE("arena_allocator falls back to the heap", "[arena]")
+{
+	memory::arena arena(std::make_shared<test::counting_allocator>());
+	std::vector<int, memory::arena_allocator<int>> in_arena{ memory::arena_allocator<int>(&arena) };
+	std::vector<int, memory::arena_allocator<int>> on_heap;
+
+	for (int i = 0; i < 100; ++i) {
+		in_arena.push_back(i);
+		on_heap.push_back(i);
+	}
+
+	CHECK(arena.capacity() > 0);
+	CHECK(in_arena == on_heap);
+
+	// a copy does not inherit the arena
+	auto copy = in_arena;
+
+	CHECK(copy.get_allocator().arena() == nullptr);
+}
\ No newline at end of file
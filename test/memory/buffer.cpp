@@ -0,0 +1,295 @@
+#include "../counting_allocator.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstring>
+#include <fast_cgi/exception/interrupted_error.hpp>
+#include <fast_cgi/memory/buffer.hpp>
+#include <limits>
+#include <string>
+#include <thread>
+
+using namespace fast_cgi;
+
+namespace {
+
+constexpr auto unlimited = std::numeric_limits<std::size_t>::max();
+
+std::size_t write(memory::buffer::writer& writer, const char* data, std::size_t size)
+{
+	std::size_t written = 0;
+
+	while (written < size) {
+		auto buffer = writer.request_buffer(size - written);
+
+		if (!buffer.second) {
+			break;
+		}
+
+		std::memcpy(buffer.first, data + written, buffer.second);
+
+		written += buffer.second;
+	}
+
+	// publish
+	writer.request_buffer(0);
+
+	return written;
+}
+
+std::string read_all(memory::buffer& buffer)
+{
+	std::string content;
+
+	while (true) {
+		auto input = buffer.wait_for_input();
+
+		if (!input.second) {
+			return content;
+		}
+
+		content.append(static_cast<const char*>(input.first), input.second);
+	}
+}
+
+std::string pattern(std::size_t size)
+{
+	std::string content(size, '\0');
+
+	for (std::size_t i = 0; i < size; ++i) {
+		content[i] = static_cast<char>(i * 31 + i / 251);
+	}
+
+	return content;
+}
+
+} // namespace
+
+TEST_CASE("buffer passes the content in order", "[buffer]")
+{
+	auto allocator = std::make_shared<test::counting_allocator>();
+	auto content   = pattern(300000);
+
+	{
+		memory::buffer buffer(allocator, unlimited, 64, 4096);
+		auto writer = buffer.begin_writing();
+
+		REQUIRE(write(writer, content.data(), content.size()) == content.size());
+
+		CHECK(buffer.size() == content.size());
+
+		writer.close();
+		buffer.close();
+
+		CHECK(read_all(buffer) == content);
+		CHECK(buffer.input_closed());
+	}
+
+	CHECK(allocator->used == 0);
+}
+
+TEST_CASE("buffer stops at its maximum size", "[buffer]")
+{
+	memory::buffer buffer(std::make_shared<test::counting_allocator>(), 100);
+	auto writer  = buffer.begin_writing();
+	auto content = pattern(150);
+
+	CHECK(write(writer, content.data(), content.size()) == 100);
+	CHECK(buffer.output_closed());
+	CHECK(read_all(buffer) == content.substr(0, 100));
+}
+
+TEST_CASE("buffer recycles consumed pages", "[buffer]")
+{
+	auto allocator = std::make_shared<test::counting_allocator>();
+	memory::buffer buffer(allocator, unlimited, 1024, 4096);
+	auto writer  = buffer.begin_writing();
+	auto content = pattern(3000);
+
+	// the reader keeps up with the writer, so only a few pages are ever needed
+	for (int i = 0; i < 2000; ++i) {
+		REQUIRE(write(writer, content.data(), content.size()) == content.size());
+
+		std::string read;
+
+		while (read.size() < content.size()) {
+			auto input = buffer.wait_for_input();
+
+			read.append(static_cast<const char*>(input.first), input.second);
+		}
+
+		REQUIRE(read == content);
+	}
+
+	CHECK(allocator->allocations < 16);
+	CHECK(allocator->peak <= 8 * 4096);
+	CHECK(buffer.size() == 0);
+}
+
+TEST_CASE("buffer keeps recycled pages after a reset", "[buffer]")
+{
+	auto allocator = std::make_shared<test::counting_allocator>();
+	memory::buffer buffer(allocator, unlimited, 1024, 1024);
+	auto content = pattern(4096);
+
+	for (int i = 0; i < 100; ++i) {
+		buffer.reset(unlimited);
+
+		auto writer = buffer.begin_writing();
+
+		REQUIRE(write(writer, content.data(), content.size()) == content.size());
+
+		writer.close();
+		buffer.close();
+
+		REQUIRE(read_all(buffer) == content);
+	}
+
+	CHECK(allocator->allocations <= 8);
+}
+
+TEST_CASE("buffer hands the content to another thread", "[buffer]")
+{
+	auto allocator = std::make_shared<test::counting_allocator>();
+	auto content   = pattern(8 << 20);
+	std::string read;
+
+	{
+		memory::buffer buffer(allocator, content.size());
+
+		buffer.set_capacity(65536);
+
+		std::thread consumer([&] { read = read_all(buffer); });
+		auto writer = buffer.begin_writing();
+
+		for (std::size_t offset = 0; offset < content.size();) {
+			REQUIRE(buffer.wait_for_space());
+
+			// the producer waits while the capacity is exceeded
+			CHECK(buffer.size() <= 65536);
+
+			auto size = std::min<std::size_t>(content.size() - offset, 5000);
+
+			REQUIRE(write(writer, content.data() + offset, size) == size);
+
+			offset += size;
+		}
+
+		consumer.join();
+	}
+
+	CHECK(read == content);
+	CHECK(allocator->peak <= 65536 * 8);
+	CHECK(allocator->used == 0);
+}
+
+TEST_CASE("buffer wakes up blocked threads", "[buffer]")
+{
+	memory::buffer buffer(std::make_shared<test::counting_allocator>(), unlimited);
+
+	SECTION("interrupting the consumer")
+	{
+		std::thread interrupter([&] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			buffer.interrupt_all_waiting();
+		});
+
+		CHECK_THROWS_AS(buffer.wait_for_input(), exception::interrupted_error);
+
+		interrupter.join();
+	}
+
+	SECTION("waiting for the consumer of another buffer")
+	{
+		memory::buffer other(std::make_shared<test::counting_allocator>(), unlimited);
+		auto writer  = buffer.begin_writing();
+		auto content = pattern(100);
+
+		buffer.set_capacity(10);
+		write(writer, content.data(), content.size());
+
+		std::string read = "unset";
+
+		// the consumer blocks on the other buffer, so the producer must continue with this one
+		std::thread consumer([&] { read = read_all(other); });
+
+		CHECK(buffer.wait_for_space(&other));
+
+		other.close();
+		consumer.join();
+
+		CHECK(read.empty());
+	}
+
+	SECTION("abandoning the producer")
+	{
+		auto writer  = buffer.begin_writing();
+		auto content = pattern(100);
+
+		buffer.set_capacity(10);
+		write(writer, content.data(), content.size());
+
+		std::thread abandoner([&] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			buffer.abandon();
+		});
+
+		CHECK_FALSE(buffer.wait_for_space());
+
+		abandoner.join();
+	}
+}
+
+TEST_CASE("buffer throughput and handoff latency", "[buffer][!benchmark]")
+{
+	auto allocator = std::make_shared<test::counting_allocator>();
+	auto content   = pattern(16 << 20);
+
+	for (std::size_t chunk : { 1024, 16384 }) {
+		BENCHMARK("16 MiB in writes of " + std::to_string(chunk) + " bytes to another thread")
+		{
+			memory::buffer buffer(allocator, content.size());
+			std::size_t read = 0;
+
+			buffer.set_capacity(1 << 20);
+
+			std::thread consumer([&] {
+				for (auto input = buffer.wait_for_input(); input.second; input = buffer.wait_for_input()) {
+					read += input.second;
+				}
+			});
+			auto writer = buffer.begin_writing();
+
+			for (std::size_t offset = 0; offset < content.size(); offset += chunk) {
+				buffer.wait_for_space();
+				write(writer, content.data() + offset, std::min(chunk, content.size() - offset));
+			}
+
+			consumer.join();
+
+			return read;
+		};
+	}
+
+	memory::buffer ping(allocator, unlimited);
+	memory::buffer pong(allocator, unlimited);
+	auto ping_writer = ping.begin_writing();
+	auto pong_writer = pong.begin_writing();
+
+	// echoes every byte
+	std::thread echo([&] {
+		for (auto input = ping.wait_for_input(); input.second; input = ping.wait_for_input()) {
+			write(pong_writer, static_cast<const char*>(input.first), input.second);
+		}
+	});
+
+	BENCHMARK("a round trip of one byte")
+	{
+		write(ping_writer, "x", 1);
+
+		return pong.wait_for_input().second;
+	};
+
+	ping_writer.close();
+	ping.close();
+	echo.join();
+}
\ No newline at end of file
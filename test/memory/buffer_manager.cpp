@@ -0,0 +1,124 @@
+#include "../counting_allocator.hpp"
+
+#include <catch2/catch.hpp>
+#include <fast_cgi/memory/buffer_manager.hpp>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace fast_cgi;
+
+TEST_CASE("buffer_manager hands out pages in size classes", "[buffer_manager]")
+{
+	auto allocator = std::make_shared<test::counting_allocator>();
+	memory::buffer_manager pages(1024, allocator);
+
+	auto small = pages.new_page();
+	auto large = pages.new_page(5000);
+	auto max   = pages.new_page(1 << 20);
+
+	CHECK(memory::buffer_manager::page_size(small) == pages.page_size());
+	CHECK(memory::buffer_manager::page_size(large) >= 5000);
+	CHECK(memory::buffer_manager::page_size(large) < 2 * 5000);
+	CHECK(memory::buffer_manager::page_size(max) == pages.max_size());
+
+	// a full page still fits into a record
+	CHECK(pages.max_size() <= 65535);
+
+	pages.free_page(small);
+	pages.free_page(large);
+	pages.free_page(max);
+
+	// the free pages are reused
+	CHECK(pages.new_page() == small);
+	CHECK(pages.new_page(5000) == large);
+	CHECK(allocator->allocations == 3);
+}
+
+TEST_CASE("page_handle counts the references of a page", "[buffer_manager]")
+{
+	auto allocator = std::make_shared<test::counting_allocator>();
+	memory::buffer_manager pages(1024, allocator);
+	auto page = pages.new_page();
+
+	{
+		auto handle = memory::buffer_manager::adopt(page);
+		auto copy   = handle;
+		auto moved  = std::move(handle);
+
+		CHECK_FALSE(handle);
+		CHECK(copy.get() == page);
+		CHECK(moved.get() == page);
+
+		memory::page_handle assigned;
+
+		assigned = copy;
+		copy     = memory::page_handle();
+
+		CHECK_FALSE(copy);
+
+		// still referenced
+		CHECK(pages.new_page() != page);
+	}
+
+	// the last release returned the page to the free list
+	CHECK(pages.new_page() == page);
+	CHECK(allocator->allocations == 2);
+}
+
+TEST_CASE("buffer_manager keeps a limited amount of free pages", "[buffer_manager]")
+{
+	auto allocator = std::make_shared<test::counting_allocator>();
+
+	{
+		memory::buffer_manager pages(1024, allocator);
+		std::vector<void*> small;
+		std::vector<void*> large;
+
+		for (std::size_t i = 0; i < 2 * memory::buffer_manager::max_free; ++i) {
+			small.push_back(pages.new_page());
+			large.push_back(pages.new_page(pages.max_size()));
+		}
+
+		for (auto page : small) {
+			pages.free_page(page);
+		}
+
+		for (auto page : large) {
+			pages.free_page(page);
+		}
+
+		// at least one page of the largest class is kept
+		CHECK(allocator->deallocations == 3 * memory::buffer_manager::max_free - 1);
+	}
+
+	// the manager releases the rest
+	CHECK(allocator->used == 0);
+}
+
+TEST_CASE("page_handle releases pages from many threads", "[buffer_manager]")
+{
+	auto allocator = std::make_shared<test::counting_allocator>();
+	memory::buffer_manager pages(1024, allocator);
+	std::vector<memory::page_handle> handles;
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 1000; ++i) {
+		handles.push_back(memory::buffer_manager::adopt(pages.new_page()));
+	}
+
+	// every thread drops its own references
+	for (int i = 0; i < 4; ++i) {
+		threads.emplace_back([](std::vector<memory::page_handle> copies) { copies.clear(); }, handles);
+	}
+
+	handles.clear();
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	// every page was released exactly once
+	CHECK(allocator->deallocations == 1000 - memory::buffer_manager::max_free);
+}
\ No newline at end of file
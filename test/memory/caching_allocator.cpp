@@ -0,0 +1,239 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fast_cgi/memory/caching_allocator.hpp>
+#include <fast_cgi/memory/simple_allocator.hpp>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace fast_cgi;
+
+namespace {
+
+typedef memory::caching_allocator allocator_type;
+
+bool aligned(const void* ptr)
+{
+	return reinterpret_cast<std::uintptr_t>(ptr) % allocator_type::alignment == 0;
+}
+
+/**
+  Allocates pages on some threads and frees them on others, like the input threads and the role threads do.
+ */
+void churn(memory::allocator& allocator, int thread_count, std::size_t rounds)
+{
+	typedef std::vector<std::pair<void*, std::size_t>> pages_type;
+	std::vector<std::thread> threads;
+	std::vector<pages_type> handed(thread_count);
+
+	for (int t = 0; t < thread_count; ++t) {
+		threads.emplace_back([&allocator, &handed, t, rounds] {
+			pages_type local;
+
+			for (std::size_t i = 0; i < rounds; ++i) {
+				auto size = i % 4 ? 1024 : 4096;
+
+				// every fourth page is freed by another thread
+				(i % 4 ? local : handed[t]).emplace_back(allocator.allocate(size, 16), size);
+
+				// keep a few pages alive
+				if (local.size() == 32) {
+					for (auto page : local) {
+						allocator.deallocate(page.first, page.second);
+					}
+
+					local.clear();
+				}
+			}
+
+			for (auto page : local) {
+				allocator.deallocate(page.first, page.second);
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	threads.clear();
+
+	for (int t = 0; t < thread_count; ++t) {
+		threads.emplace_back([&allocator, &handed, t, thread_count] {
+			for (auto page : handed[(t + 1) % thread_count]) {
+				allocator.deallocate(page.first, page.second);
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+} // namespace
+
+TEST_CASE("caching_allocator rounds sizes up to their class", "[caching_allocator]")
+{
+	struct size_class
+	{
+		std::size_t size;
+		std::size_t class_size;
+	};
+
+	const size_class classes[] = { { 1, 64 },       { 64, 64 },       { 65, 128 },      { 128, 128 },
+		                           { 129, 256 },    { 1000, 1024 },   { 4096, 4096 },   { 4097, 8192 },
+		                           { 32769, 65536 }, { 65536, 65536 } };
+
+	for (auto c : classes) {
+		allocator_type allocator;
+		auto ptr = allocator.allocate(c.size, 1);
+
+		REQUIRE(ptr);
+		CHECK(aligned(ptr));
+		// a slab of one batch of the class is reserved
+		CHECK(allocator.stats().reserved == c.class_size * allocator_type::batch_size);
+		CHECK(allocator.stats().large_allocations == 0);
+
+		// the whole class is usable
+		std::memset(ptr, 0xab, c.class_size);
+
+		allocator.deallocate(ptr, c.size);
+	}
+}
+
+TEST_CASE("caching_allocator forwards large sizes", "[caching_allocator]")
+{
+	allocator_type allocator;
+	auto ptr = allocator.allocate(allocator_type::max_class_size + 1, 64);
+
+	REQUIRE(ptr);
+	CHECK(aligned(ptr));
+	CHECK(allocator.stats().large_allocations == 1);
+	CHECK(allocator.stats().reserved == 0);
+
+	std::memset(ptr, 0, allocator_type::max_class_size + 1);
+	allocator.deallocate(ptr, allocator_type::max_class_size + 1);
+}
+
+TEST_CASE("caching_allocator reuses freed blocks", "[caching_allocator]")
+{
+	allocator_type allocator;
+	std::vector<void*> blocks;
+	std::set<std::uintptr_t> addresses;
+
+	for (std::size_t i = 0; i < allocator_type::batch_size; ++i) {
+		blocks.push_back(allocator.allocate(3000, 1));
+		addresses.insert(reinterpret_cast<std::uintptr_t>(blocks.back()));
+	}
+
+	// the blocks of one slab do not overlap
+	REQUIRE(addresses.size() == blocks.size());
+
+	for (auto i = addresses.begin(), j = std::next(i); j != addresses.end(); ++i, ++j) {
+		CHECK(*j - *i >= 4096);
+	}
+
+	auto reserved = allocator.stats().reserved;
+
+	for (int round = 0; round < 1000; ++round) {
+		for (auto block : blocks) {
+			allocator.deallocate(block, 3000);
+		}
+
+		for (auto& block : blocks) {
+			block = allocator.allocate(3000, 1);
+
+			REQUIRE(addresses.count(reinterpret_cast<std::uintptr_t>(block)));
+		}
+	}
+
+	CHECK(allocator.stats().reserved == reserved);
+
+	for (auto block : blocks) {
+		allocator.deallocate(block, 3000);
+	}
+}
+
+TEST_CASE("caching_allocator passes blocks freed on another thread back", "[caching_allocator]")
+{
+	constexpr std::size_t count = 64 * allocator_type::batch_size;
+	allocator_type allocator;
+	std::vector<void*> blocks;
+
+	for (std::size_t i = 0; i < count; ++i) {
+		blocks.push_back(allocator.allocate(4096, 1));
+	}
+
+	auto reserved = allocator.stats().reserved;
+
+	CHECK(reserved == count * 4096);
+
+	// the consumer thread returns the blocks to the depot in batches
+	std::thread([&] {
+		for (auto block : blocks) {
+			allocator.deallocate(block, 4096);
+		}
+	}).join();
+
+	CHECK(allocator.stats().depot_blocks == count);
+
+	for (auto& block : blocks) {
+		block = allocator.allocate(4096, 1);
+	}
+
+	CHECK(allocator.stats().reserved == reserved);
+	CHECK(allocator.stats().depot_blocks == 0);
+
+	for (auto block : blocks) {
+		allocator.deallocate(block, 4096);
+	}
+}
+
+TEST_CASE("caching_allocator honours the alignment", "[caching_allocator]")
+{
+	allocator_type allocator;
+
+	for (std::size_t size = 1; size <= allocator_type::max_class_size; size *= 3) {
+		for (std::size_t align = 1; align <= size; align *= 2) {
+			auto ptr = allocator.allocate(size, align);
+
+			INFO(size << " " << align);
+			CHECK(reinterpret_cast<std::uintptr_t>(ptr) % align == 0);
+
+			allocator.deallocate(ptr, size);
+		}
+	}
+
+	// large sizes take any alignment
+	auto ptr = allocator.allocate(allocator_type::max_class_size + 1, 1 << 20);
+
+	CHECK(reinterpret_cast<std::uintptr_t>(ptr) % (1 << 20) == 0);
+
+	allocator.deallocate(ptr, allocator_type::max_class_size + 1);
+
+	CHECK_THROWS_AS(allocator.allocate(100, 256), std::invalid_argument);
+	CHECK_THROWS_AS(allocator.allocate(100, 48), std::invalid_argument);
+}
+
+TEST_CASE("caching_allocator under multi-threaded churn", "[caching_allocator][!benchmark]")
+{
+	memory::simple_allocator simple;
+	allocator_type caching;
+
+	for (auto thread_count : { 1, 4, 16 }) {
+		BENCHMARK("malloc with " + std::to_string(thread_count) + " threads")
+		{
+			churn(simple, thread_count, 10000);
+		};
+
+		BENCHMARK("caching_allocator with " + std::to_string(thread_count) + " threads")
+		{
+			churn(caching, thread_count, 10000);
+		};
+	}
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "../counting_allocator.hpp"
+
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <fast_cgi/memory/governor.hpp>
+#include <memory>
+#include <thread>
+
+using namespace fast_cgi;
+
+namespace {
+
+typedef memory::governor::CATEGORY CATEGORY;
+
+std::size_t category(const memory::governor& governor, CATEGORY category)
+{
+	return governor.stats().categories[static_cast<int>(category)];
+}
+
+} // namespace
+
+TEST_CASE("governor accounts the allocations to their categories", "[governor]")
+{
+	auto governor = std::make_shared<memory::governor>(1000);
+	auto counting = std::make_shared<test::counting_allocator>();
+	auto input    = governor->track(counting, CATEGORY::input);
+	auto output   = governor->track(counting, CATEGORY::output);
+
+	auto a = input->allocate(300, 8);
+	auto b = output->allocate(200, 8);
+	auto c = output->allocate(100, 8);
+
+	CHECK(governor->stats().used == 600);
+	CHECK(category(*governor, CATEGORY::input) == 300);
+	CHECK(category(*governor, CATEGORY::output) == 300);
+	CHECK(category(*governor, CATEGORY::params) == 0);
+	CHECK(counting->used == 600);
+
+	output->deallocate(b, 200);
+	input->deallocate(a, 300);
+
+	CHECK(governor->stats().used == 100);
+	CHECK(governor->stats().peak == 600);
+	CHECK(category(*governor, CATEGORY::input) == 0);
+	CHECK(category(*governor, CATEGORY::output) == 100);
+
+	output->deallocate(c, 100);
+
+	CHECK(counting->used == 0);
+}
+
+TEST_CASE("governor is under pressure from the limit on", "[governor]")
+{
+	auto governor = std::make_shared<memory::governor>(1000);
+	auto tracked  = governor->track(std::make_shared<test::counting_allocator>(), CATEGORY::params);
+
+	auto a = tracked->allocate(999, 8);
+
+	CHECK_FALSE(governor->under_pressure());
+
+	auto b = tracked->allocate(1, 8);
+
+	CHECK(governor->under_pressure());
+
+	governor->refuse();
+	governor->refuse();
+
+	CHECK(governor->stats().refused == 2);
+
+	tracked->deallocate(b, 1);
+
+	CHECK_FALSE(governor->under_pressure());
+
+	tracked->deallocate(a, 999);
+}
+
+TEST_CASE("governor throttles until the memory is released", "[governor]")
+{
+	auto governor = std::make_shared<memory::governor>(1000);
+	auto tracked  = governor->track(std::make_shared<test::counting_allocator>(), CATEGORY::output);
+
+	// nothing blocks without pressure
+	governor->throttle([] { return false; });
+
+	CHECK(governor->stats().throttled == 0);
+
+	auto a = tracked->allocate(600, 8);
+	auto b = tracked->allocate(600, 8);
+
+	// a drained caller is never blocked
+	governor->throttle([] { return true; });
+
+	CHECK(governor->stats().throttled == 0);
+
+	SECTION("a release wakes the throttled caller")
+	{
+		std::atomic_bool released{ false };
+		std::thread releaser([&] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			released = true;
+
+			tracked->deallocate(b, 600);
+		});
+
+		governor->throttle([] { return false; });
+
+		CHECK(released);
+		CHECK_FALSE(governor->under_pressure());
+		CHECK(governor->stats().throttled == 1);
+
+		releaser.join();
+	}
+
+	SECTION("a release above the limit does not")
+	{
+		auto c = tracked->allocate(600, 8);
+		std::atomic_bool drained{ false };
+		std::thread releaser([&] {
+			tracked->deallocate(c, 600);
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			drained = true;
+		});
+
+		// still under pressure; the caller waits until it has drained
+		governor->throttle([&drained] { return drained.load(); });
+
+		CHECK(drained);
+		CHECK(governor->under_pressure());
+
+		releaser.join();
+		tracked->deallocate(b, 600);
+	}
+
+	tracked->deallocate(a, 600);
+}
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fast_cgi/memory/buffer_manager.hpp>
+#include <fast_cgi/memory/huge_page_allocator.hpp>
+#include <fast_cgi/memory/simple_allocator.hpp>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#	include <linux/perf_event.h>
+#	include <sys/ioctl.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif
+
+using namespace fast_cgi;
+
+namespace {
+
+bool aligned(const void* ptr, std::size_t align)
+{
+	return reinterpret_cast<std::uintptr_t>(ptr) % align == 0;
+}
+
+/**
+  Counts the data TLB misses of this thread if the system permits it.
+ */
+class tlb_counter
+{
+public:
+	tlb_counter()
+	{
+		_fd = -1;
+
+#if defined(__linux__)
+		perf_event_attr attr{};
+
+		attr.size           = sizeof(attr);
+		attr.type           = PERF_TYPE_HW_CACHE;
+		attr.disabled       = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv     = 1;
+
+		// read misses of the data TLB
+		attr.config =
+		    PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+
+		_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+	}
+	~tlb_counter()
+	{
+#if defined(__linux__)
+		if (_fd != -1) {
+			close(_fd);
+		}
+#endif
+	}
+	bool available() const noexcept
+	{
+		return _fd != -1;
+	}
+	/**
+	  Returns the misses while the function ran.
+	 */
+	template<typename Function>
+	long long count(Function function)
+	{
+		long long misses = 0;
+
+#if defined(__linux__)
+		if (_fd != -1) {
+			ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+
+		function();
+
+		if (_fd != -1) {
+			ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+			if (read(_fd, &misses, sizeof(misses)) != sizeof(misses)) {
+				misses = -1;
+			}
+		}
+#else
+		function();
+#endif
+
+		return misses;
+	}
+
+private:
+	int _fd;
+};
+
+/**
+  Holds the pages of many connections and touches them in random order.
+ */
+struct connections
+{
+	memory::allocator& allocator;
+	std::vector<std::pair<char*, std::size_t>> pages;
+	std::vector<std::size_t> order;
+
+	connections(memory::allocator& allocator, std::size_t count, std::size_t touches = 1000000) : allocator(allocator)
+	{
+		std::mt19937 random(1);
+
+		for (std::size_t i = 0; i < count; ++i) {
+			auto size = i % 4 ? std::size_t(1024) : std::size_t(4096);
+
+			pages.emplace_back(static_cast<char*>(allocator.allocate(size, 64)), size);
+			std::memset(pages.back().first, 0, size);
+		}
+
+		for (std::size_t i = 0; i < touches; ++i) {
+			order.push_back(random() % count);
+		}
+	}
+	~connections()
+	{
+		for (auto page : pages) {
+			allocator.deallocate(page.first, page.second);
+		}
+	}
+	int touch()
+	{
+		int sum = 0;
+
+		for (auto index : order) {
+			sum += ++pages[index].first[index % pages[index].second];
+		}
+
+		return sum;
+	}
+};
+
+} // namespace
+
+TEST_CASE("huge_page_allocator carves the largest pages out of its regions", "[huge_page_allocator]")
+{
+	memory::huge_page_allocator allocator;
+	auto size = memory::buffer_manager::max_page_size;
+	auto ptr  = allocator.allocate(size, 64);
+
+	REQUIRE(ptr);
+	CHECK(allocator.stats().regions == 1);
+
+	std::memset(ptr, 0xab, size);
+	allocator.deallocate(ptr, size);
+
+	// a freed block is reused
+	CHECK(allocator.allocate(size, 64) == ptr);
+
+	allocator.deallocate(ptr, size);
+}
+
+TEST_CASE("huge_page_allocator keeps the size classes apart", "[huge_page_allocator]")
+{
+	memory::huge_page_allocator allocator;
+	std::vector<std::pair<char*, std::size_t>> blocks;
+
+	for (auto size = memory::huge_page_allocator::min_block_size / 2;
+	     size <= memory::huge_page_allocator::max_block_size; size *= 2) {
+		for (int i = 0; i < 8; ++i) {
+			auto ptr = static_cast<char*>(allocator.allocate(size + 1, 1));
+
+			std::memset(ptr, static_cast<int>(blocks.size()), size + 1);
+			blocks.emplace_back(ptr, size + 1);
+		}
+	}
+
+	// every block kept its content
+	for (std::size_t i = 0; i < blocks.size(); ++i) {
+		auto block = blocks[i];
+
+		CHECK(block.first[0] == static_cast<char>(i));
+		CHECK(block.first[block.second - 1] == static_cast<char>(i));
+	}
+
+	for (auto block : blocks) {
+		allocator.deallocate(block.first, block.second);
+	}
+}
+
+TEST_CASE("huge_page_allocator aligns every block to its size", "[huge_page_allocator]")
+{
+	memory::huge_page_allocator allocator;
+	std::vector<std::pair<void*, std::size_t>> blocks;
+	std::mt19937 random(3);
+
+	// mixed classes leave gaps in front of the larger blocks
+	for (int i = 0; i < 2000; ++i) {
+		auto size = memory::huge_page_allocator::min_block_size << random() % 7;
+		auto ptr  = allocator.allocate(size, size);
+
+		INFO(size);
+		REQUIRE(aligned(ptr, size));
+
+		std::memset(ptr, i, size);
+		blocks.emplace_back(ptr, size);
+	}
+
+	// the gaps were reused and nothing overlaps
+	for (std::size_t i = 0; i < blocks.size(); ++i) {
+		auto block = static_cast<unsigned char*>(blocks[i].first);
+
+		CHECK(block[0] == static_cast<unsigned char>(i));
+		CHECK(block[blocks[i].second - 1] == static_cast<unsigned char>(i));
+	}
+
+	for (auto block : blocks) {
+		allocator.deallocate(block.first, block.second);
+	}
+
+	auto large = allocator.allocate(memory::huge_page_allocator::max_block_size + 1, 1 << 16);
+
+	CHECK(aligned(large, 1 << 16));
+
+	allocator.deallocate(large, memory::huge_page_allocator::max_block_size + 1);
+
+	CHECK_THROWS_AS(allocator.allocate(1024, 2048), std::invalid_argument);
+	CHECK_THROWS_AS(allocator.allocate(1024, 24), std::invalid_argument);
+}
+
+TEST_CASE("huge_page_allocator reduces TLB misses", "[huge_page_allocator][!benchmark]")
+{
+	constexpr std::size_t count = 65536;
+	memory::simple_allocator simple;
+	memory::huge_page_allocator huge(memory::huge_page_allocator::default_region_size, 64 << 20);
+	connections simple_connections(simple, count);
+	connections huge_connections(huge, count);
+	tlb_counter counter;
+
+	if (counter.available()) {
+		WARN("dTLB read misses with malloc: " << counter.count([&] { simple_connections.touch(); }));
+		WARN("dTLB read misses with huge pages: " << counter.count([&] { huge_connections.touch(); }));
+	} else {
+		WARN("perf counters are not permitted; only measuring the throughput");
+	}
+
+	WARN("huge page regions: " << huge.stats().hugetlb_regions << " hugetlb, " << huge.stats().advised_regions
+	                           << " advised of " << huge.stats().regions);
+
+	BENCHMARK("touching pages from malloc")
+	{
+		return simple_connections.touch();
+	};
+
+	BENCHMARK("touching pages from huge pages")
+	{
+		return huge_connections.touch();
+	};
+
+	BENCHMARK("allocating pages from malloc")
+	{
+		connections c(simple, 4096, 0);
+	};
+
+	BENCHMARK("allocating pages from huge pages")
+	{
+		connections c(huge, 4096, 0);
+	};
+}
\ No newline at end of file
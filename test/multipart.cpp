@@ -0,0 +1,257 @@
+#include "counting_allocator.hpp"
+
+#include <algorithm>
+#include <catch2/catch.hpp>
+#include <fast_cgi/exception/parse_error.hpp>
+#include <fast_cgi/io/byte_stream.hpp>
+#include <fast_cgi/memory/buffer.hpp>
+#include <fast_cgi/multipart.hpp>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace fast_cgi;
+
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string>> parts_type;
+
+struct form
+{
+	std::string boundary;
+	std::string content;
+	parts_type parts;
+};
+
+/** collects the parts reported by the parser */
+struct collector
+{
+	parts_type parts;
+	std::size_t ended = 0;
+	bool empty_chunk  = false;
+	multipart parser;
+
+	collector(string_view boundary, std::size_t max_header_size = multipart::default_max_header_size)
+	    : parser(
+	          boundary,
+	          [this](string_view headers) { parts.emplace_back(std::string(headers.data(), headers.size()), ""); },
+	          [this](string_view chunk) {
+		          empty_chunk = empty_chunk || chunk.empty();
+
+		          parts.back().second.append(chunk.data(), chunk.size());
+	          },
+	          [this] { ++ended; }, max_header_size)
+	{}
+};
+
+/**
+  Creates text with many fragments of the delimiter, so that the vector kernels find candidates at every position
+  of a block.
+ */
+std::string random_text(std::mt19937& random, const std::string& boundary, std::size_t size)
+{
+	const std::string fragments[] = { "\r", "\n", "-", "--", "\r\n", "\r\n-", "\r\n--", boundary.substr(0, 1),
+		                              boundary.substr(0, boundary.size() - 1), "--" + boundary.substr(1) };
+	std::string text;
+
+	while (text.size() < size) {
+		auto c = random() % 24;
+
+		if (c < 10) {
+			text += fragments[c];
+		} else {
+			text += static_cast<char>('a' + c);
+		}
+	}
+
+	return text;
+}
+
+/**
+  Builds a form whose bodies never contain the delimiter, so the parts are known without searching it.
+ */
+form random_form(std::mt19937& random, const std::string& boundary, std::size_t count, std::size_t max_size)
+{
+	const auto delimiter = "\r\n--" + boundary;
+	form f;
+
+	f.boundary = boundary;
+
+	// a preamble or the boundary at the very beginning
+	if (random() % 2) {
+		std::string preamble;
+
+		do {
+			preamble = random_text(random, boundary, random() % 50);
+		} while (("\r\n" + preamble + delimiter).find(delimiter) != preamble.size() + 2);
+
+		f.content = preamble + delimiter;
+	} else {
+		f.content = "--" + boundary;
+	}
+
+	for (std::size_t i = 0; i < count; ++i) {
+		std::string headers = i % 3 ? "Content-Disposition: form-data; name=\"field" + std::to_string(i) + "\"" : "";
+		std::string body;
+
+		if (i % 3 == 2) {
+			headers += "\r\nContent-Type: application/octet-stream";
+		}
+
+		do {
+			body = random_text(random, boundary, random() % max_size);
+		} while ((body + delimiter).find(delimiter) != body.size());
+
+		f.content += "\r\n" + (headers.empty() ? "" : headers + "\r\n") + "\r\n" + body + delimiter;
+		f.parts.emplace_back(headers, body);
+	}
+
+	f.content += "--\r\nepilogue " + delimiter;
+
+	return f;
+}
+
+parts_type feed(const form& f, const std::vector<std::size_t>& sizes)
+{
+	collector c(f.boundary);
+	std::size_t offset = 0;
+
+	for (std::size_t i = 0; offset < f.content.size(); ++i) {
+		auto size = std::min(sizes[i % sizes.size()], f.content.size() - offset);
+
+		c.parser.feed({ f.content.data() + offset, size });
+
+		offset += size;
+	}
+
+	CHECK(c.parser.finished());
+	CHECK(c.ended == c.parts.size());
+	CHECK_FALSE(c.empty_chunk);
+
+	return c.parts;
+}
+
+} // namespace
+
+TEST_CASE("multipart finds the delimiter at every position of a block", "[multipart]")
+{
+	for (std::size_t size = 0; size < 100; ++size) {
+		for (std::size_t position = 0; position <= size; ++position) {
+			// the body contains a candidate with the first and the last byte of the delimiter
+			std::string body(size, 'x');
+
+			body.insert(position, "\r\n--boundarX");
+
+			form f{ "boundary", "--boundary\r\n\r\n" + body + "\r\n--boundary--", { { "", body } } };
+
+			INFO(size << " " << position);
+			REQUIRE(feed(f, { f.content.size() }) == f.parts);
+		}
+	}
+}
+
+TEST_CASE("multipart splits parts independent of the chunks", "[multipart]")
+{
+	const std::string boundaries[] = { "b", "boundary", "----WebKitFormBoundary7MA4YWxkTrZu0gW", std::string(70, '-') };
+	std::mt19937 random(11);
+
+	for (auto& boundary : boundaries) {
+		for (int i = 0; i < 20; ++i) {
+			auto f = random_form(random, boundary, 1 + random() % 5, 300);
+
+			INFO(boundary << " " << i);
+			REQUIRE(feed(f, { f.content.size() }) == f.parts);
+			REQUIRE(feed(f, { 1 }) == f.parts);
+			REQUIRE(feed(f, { 15, 16, 17, 31, 32, 33, 2, 64 }) == f.parts);
+
+			std::vector<std::size_t> sizes;
+
+			for (int j = 0; j < 50; ++j) {
+				sizes.push_back(1 + random() % 100);
+			}
+
+			REQUIRE(feed(f, sizes) == f.parts);
+		}
+	}
+}
+
+TEST_CASE("multipart parses streams and pages", "[multipart]")
+{
+	std::mt19937 random(5);
+	auto f = random_form(random, "boundary", 10, 20000);
+
+	SECTION("a stream")
+	{
+		collector c(f.boundary);
+		std::istringstream input(f.content);
+
+		c.parser.parse(input);
+
+		CHECK(c.parts == f.parts);
+	}
+
+	SECTION("the pages of a buffer")
+	{
+		collector c(f.boundary);
+		auto buffer = std::make_shared<memory::buffer>(std::make_shared<test::counting_allocator>(),
+		                                               std::numeric_limits<std::size_t>::max(), 64, 64);
+		auto writer = buffer->begin_writing();
+
+		for (std::size_t offset = 0; offset < f.content.size();) {
+			auto page = writer.request_buffer(f.content.size() - offset);
+
+			std::copy_n(f.content.data() + offset, page.second, static_cast<char*>(page.first));
+
+			offset += page.second;
+		}
+
+		writer.request_buffer(0);
+		writer.close();
+		buffer->close();
+
+		io::input_streambuf pages(buffer);
+		std::istream input(&pages);
+
+		c.parser.parse(input);
+
+		CHECK(c.parts == f.parts);
+	}
+
+	SECTION("a truncated stream")
+	{
+		collector c(f.boundary);
+		std::istringstream input(f.content.substr(0, f.content.size() / 2));
+
+		CHECK_THROWS_AS(c.parser.parse(input), exception::parse_error);
+	}
+}
+
+TEST_CASE("multipart limits the headers", "[multipart]")
+{
+	collector c("b", 32);
+
+	c.parser.feed("--b\r\nName: short\r\n\r\nbody\r\n--b\r\n");
+
+	CHECK(c.parts.size() == 1);
+	CHECK_THROWS_AS(c.parser.feed("Name: " + std::string(40, 'x')), exception::parse_error);
+}
+
+TEST_CASE("multipart extracts headers and parameters", "[multipart]")
+{
+	auto headers = string_view("Content-Disposition: form-data; name=\"file\"; filename=\"a;b.txt\"\r\n"
+	                           "content-type:  text/plain ");
+
+	CHECK(multipart::header(headers, "content-disposition") ==
+	      "form-data; name=\"file\"; filename=\"a;b.txt\"");
+	CHECK(multipart::header(headers, "Content-Type") == "text/plain");
+	CHECK(multipart::header(headers, "Content-Length").empty());
+	CHECK(multipart::parameter(multipart::header(headers, "content-disposition"), "name") == "file");
+	CHECK(multipart::parameter(multipart::header(headers, "content-disposition"), "filename") == "a;b.txt");
+	CHECK(multipart::parameter("form-data", "name").empty());
+	CHECK(multipart::boundary_of("multipart/form-data; boundary=abc") == "abc");
+	CHECK(multipart::boundary_of("multipart/form-data; charset=utf-8; BOUNDARY=\"a b\"") == "a b");
+	CHECK(multipart::boundary_of("multipart/form-data").empty());
+}
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include "client.hpp"
+#include "counting_allocator.hpp"
+
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <fast_cgi/response_cache.hpp>
+#include <fast_cgi/role.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace fast_cgi;
+
+namespace {
+
+typedef response_cache::LOOKUP LOOKUP;
+
+std::atomic_int responder_runs{ 0 };
+
+/** answers with the header block given by the query string */
+class headers : public responder
+{
+public:
+	virtual status_code_type run() override
+	{
+		auto query = params().get(detail::params::VARIABLE::query_string);
+
+		++responder_runs;
+
+		output() << std::string(query.data(), query.size()) << "\r\n\r\nbody";
+
+		return 0;
+	}
+};
+
+std::shared_ptr<response_cache> make_cache(std::chrono::milliseconds ttl, std::chrono::milliseconds stale,
+                                           std::size_t max_size = 1 << 20)
+{
+	return std::make_shared<response_cache>(std::vector<std::string>{ "HTTP_HOST", "REQUEST_URI" }, ttl, stale,
+	                                        max_size);
+}
+
+} // namespace
+
+TEST_CASE("response_cache expires entries", "[response_cache]")
+{
+	auto cache = make_cache(std::chrono::milliseconds(50), std::chrono::milliseconds(0));
+
+	CHECK(cache->find("key").first == LOOKUP::miss);
+
+	cache->store("key", "content", 0);
+
+	auto result = cache->find("key");
+
+	REQUIRE(result.first == LOOKUP::hit);
+	CHECK(result.second->content == "content");
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+
+	CHECK(cache->find("key").first == LOOKUP::miss);
+	CHECK(cache->stats().entries == 0);
+	CHECK(cache->stats().size == 0);
+	CHECK(cache->stats().hits == 1);
+	CHECK(cache->stats().misses == 2);
+}
+
+TEST_CASE("response_cache serves stale entries while revalidating", "[response_cache]")
+{
+	auto cache = make_cache(std::chrono::milliseconds(50), std::chrono::milliseconds(1000));
+
+	cache->store("key", "old", 0);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+
+	// only the first lookup revalidates
+	auto result = cache->find("key");
+
+	REQUIRE(result.first == LOOKUP::revalidate);
+	CHECK(result.second->content == "old");
+	CHECK(cache->find("key").first == LOOKUP::stale);
+	CHECK(cache->stats().stale_hits == 2);
+
+	SECTION("a new response ends the revalidation")
+	{
+		cache->store("key", "new", 0);
+
+		result = cache->find("key");
+
+		REQUIRE(result.first == LOOKUP::hit);
+		CHECK(result.second->content == "new");
+	}
+
+	SECTION("an abandoned revalidation is repeated")
+	{
+		cache->abandon("key");
+
+		CHECK(cache->find("key").first == LOOKUP::revalidate);
+	}
+}
+
+TEST_CASE("response_cache evicts the least recently used entries", "[response_cache]")
+{
+	// every entry takes 1 + 99 bytes
+	auto cache   = make_cache(std::chrono::seconds(60), std::chrono::seconds(0), 300);
+	auto content = std::string(99, 'c');
+
+	cache->store("a", content, 0);
+	cache->store("b", content, 0);
+	cache->store("c", content, 0);
+
+	// `a` is used more recently than `b`
+	CHECK(cache->find("a").first == LOOKUP::hit);
+
+	cache->store("d", content, 0);
+
+	CHECK(cache->find("b").first == LOOKUP::miss);
+	CHECK(cache->find("a").first == LOOKUP::hit);
+	CHECK(cache->find("c").first == LOOKUP::hit);
+	CHECK(cache->find("d").first == LOOKUP::hit);
+	CHECK(cache->stats().evictions == 1);
+	CHECK(cache->stats().size <= cache->max_size());
+
+	// too large for the cache
+	cache->store("e", std::string(300, 'e'), 0);
+
+	CHECK(cache->find("e").first == LOOKUP::miss);
+	CHECK(cache->stats().entries == 3);
+}
+
+TEST_CASE("response_cache stores only shareable responses", "[response_cache]")
+{
+	auto cache = make_cache(std::chrono::seconds(60), std::chrono::seconds(0));
+	detail::params params;
+
+	CHECK(cache->storable(params, "Content-Type: text/plain\r\n\r\nbody"));
+	CHECK(cache->storable(params, "Status: 404 Not Found\r\n\r\n"));
+	CHECK(cache->storable(params, "Status: 301\r\nLocation: /other\r\n\r\n"));
+	CHECK_FALSE(cache->storable(params, "Location: /other\r\n\r\n"));
+	CHECK_FALSE(cache->storable(params, "Status: 500\r\n\r\n"));
+	CHECK_FALSE(cache->storable(params, "Status: 302\r\nLocation: /other\r\n\r\n"));
+
+	// the response depends on headers of the request
+	CHECK(cache->storable(params, "Vary: Host\r\n\r\n"));
+	CHECK(cache->storable(params, "vary: host, accept-encoding\r\n\r\n", true));
+	CHECK_FALSE(cache->storable(params, "Vary: Host, Accept-Encoding\r\n\r\n"));
+	CHECK_FALSE(cache->storable(params, "Vary: Host\r\nVary: Accept-Language\r\n\r\n"));
+	CHECK_FALSE(cache->storable(params, "Vary: *\r\n\r\n"));
+
+	// cookies and forbidden caching are never stored
+	const std::string rejected[] = { "Set-Cookie: a=1\r\n\r\nbody", "set-cookie: a=1\nContent-Type: text/plain\n\nbody",
+		                             "Cache-Control: no-store\r\n\r\nbody", "Cache-Control: private\r\n\r\nbody",
+		                             "Cache-Control: public, no-cache\r\n\r\nbody" };
+
+	for (auto& content : rejected) {
+		cache->store("key", content, 0);
+
+		INFO(content);
+		CHECK(cache->find("key").first == LOOKUP::miss);
+	}
+
+	// a cookie in the body is no header
+	cache->store("key", "Content-Type: text/plain\r\n\r\nSet-Cookie: a=1", 0);
+
+	CHECK(cache->find("key").first == LOOKUP::hit);
+}
+
+TEST_CASE("response_cache answers repeated requests", "[response_cache][service]")
+{
+	auto cache = make_cache(std::chrono::seconds(60), std::chrono::seconds(0));
+	test::client client(std::make_shared<test::counting_allocator>());
+
+	client.service().set_role<headers>();
+	client.service().set_response_cache(cache);
+	client.start();
+
+	auto request = [&client](const char* host, const char* headers, const test::params_type& more = {}) {
+		test::params_type params = { { "REQUEST_METHOD", "GET" },
+			                         { "HTTP_HOST", host },
+			                         { "REQUEST_URI", "/" },
+			                         { "QUERY_STRING", headers } };
+
+		params.insert(params.end(), more.begin(), more.end());
+		client.send_request(1, 1, true, params);
+
+		auto response = client.read_response();
+
+		REQUIRE(response.protocol_status == 0);
+
+		return response.output;
+	};
+
+	responder_runs = 0;
+
+	SECTION("the host is part of the key")
+	{
+		CHECK(request("a", "Status: 200") == "Status: 200\r\n\r\nbody");
+		CHECK(request("a", "Status: 201") == "Status: 200\r\n\r\nbody");
+		CHECK(request("b", "Status: 404") == "Status: 404\r\n\r\nbody");
+		CHECK(responder_runs == 2);
+	}
+
+	SECTION("responses that vary on headers outside of the key")
+	{
+		request("a", "Vary: Accept-Language");
+		request("a", "Vary: Accept-Language");
+
+		CHECK(responder_runs == 2);
+	}
+
+	SECTION("requests with credentials")
+	{
+		request("a", "Status: 200", { { "HTTP_COOKIE", "a=1" } });
+		request("a", "Status: 200", { { "HTTP_COOKIE", "a=1" } });
+
+		CHECK(responder_runs == 2);
+
+		request("a", "Cache-Control: public", { { "HTTP_AUTHORIZATION", "secret" } });
+		request("a", "Cache-Control: public", { { "HTTP_AUTHORIZATION", "secret" } });
+
+		CHECK(responder_runs == 3);
+	}
+
+	client.close();
+}
+
+TEST_CASE("response_cache revalidates stale responses in the background", "[response_cache][service]")
+{
+	auto cache = make_cache(std::chrono::milliseconds(50), std::chrono::seconds(60));
+	test::client client(std::make_shared<test::counting_allocator>());
+
+	client.service().set_role<headers>();
+	client.service().set_response_cache(cache);
+	client.start();
+
+	auto request = [&client](const char* headers) {
+		client.send_request(1, 1, true,
+		                    { { "REQUEST_METHOD", "GET" },
+		                      { "HTTP_HOST", "a" },
+		                      { "REQUEST_URI", "/" },
+		                      { "QUERY_STRING", headers } });
+
+		auto response = client.read_response();
+
+		REQUIRE(response.protocol_status == 0);
+
+		return response.output;
+	};
+
+	responder_runs = 0;
+
+	request("X-Version: 1");
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+
+	// the stale response is served while the role runs again
+	CHECK(request("X-Version: 2") == "X-Version: 1\r\n\r\nbody");
+
+	// the fresh response is served from the cache
+	for (int i = 0; i < 1000 && request("X-Version: 3") != "X-Version: 2\r\n\r\nbody"; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	CHECK(request("X-Version: 3") == "X-Version: 2\r\n\r\nbody");
+	CHECK(responder_runs == 2);
+
+	client.close();
+}
\ No newline at end of file
@@ -0,0 +1,530 @@
+#include "client.hpp"
+#include "counting_allocator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fast_cgi/detail/request.hpp>
+#include <fast_cgi/memory/governor.hpp>
+#include <fast_cgi/response_cache.hpp>
+#include <fast_cgi/role.hpp>
+#include <string>
+#include <thread>
+
+using namespace fast_cgi;
+
+namespace {
+
+typedef memory::governor::CATEGORY CATEGORY;
+
+/** answers with the size of the input */
+class echo : public responder
+{
+public:
+	virtual status_code_type run() override
+	{
+		char buffer[1024];
+		std::size_t size = 0;
+
+		while (input().read(buffer, sizeof(buffer)), input().gcount()) {
+			size += static_cast<std::size_t>(input().gcount());
+		}
+
+		output() << "Content-Type: text/plain\r\n\r\n" << size;
+
+		return 0;
+	}
+};
+
+std::atomic_bool filter_blocked{ false };
+
+/** does not read the data stream until it is released */
+class lazy_filter : public filter
+{
+public:
+	virtual status_code_type run() override
+	{
+		while (filter_blocked.load()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		char buffer[4096];
+		std::size_t size = 0;
+
+		while (data().read(buffer, sizeof(buffer)), data().gcount()) {
+			size += static_cast<std::size_t>(data().gcount());
+		}
+
+		output() << "Content-Type: text/plain\r\n\r\n" << size;
+
+		return 0;
+	}
+};
+
+std::atomic_bool streaming{ false };
+std::atomic_int cancel_calls{ 0 };
+
+/** writes output until the request is cancelled and once more afterwards */
+class streamer : public responder
+{
+public:
+	virtual status_code_type run() override
+	{
+		on_cancel([] { ++cancel_calls; });
+
+		output() << "Content-Type: text/plain\r\n\r\n";
+
+		for (int i = 0; i < 10000 && !is_cancelled(); ++i) {
+			output() << "chunk " << i << "\n";
+			output().flush();
+
+			streaming = true;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		// the output of a cancelled request is discarded
+		output() << "cancelled";
+		output().flush();
+
+		streaming = false;
+
+		return is_cancelled() ? 1 : 0;
+	}
+};
+
+void wait_for(const std::atomic_bool& flag, bool value)
+{
+	for (int i = 0; i < 10000 && flag != value; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	REQUIRE(flag == value);
+}
+
+/** writes with the stream and with the buffer behind it */
+class mixed : public responder
+{
+public:
+	virtual status_code_type run() override
+	{
+		auto& buffer = output_buffer();
+
+		output() << "Content-Type: text/plain\r\n\r\n" << 1;
+
+		if (auto ptr = buffer.reserve(2)) {
+			ptr[0] = ',';
+			ptr[1] = '2';
+			buffer.commit(2);
+		}
+
+		buffer.write({ { ",", 1 }, { "3", 1 } });
+		output() << ',' << 4.5;
+		format(",{},{}", 6, "seven");
+		buffer.adopt(std::string(",8"));
+		output() << std::endl;
+
+		return 0;
+	}
+};
+
+/** writes the amount of lines given by the query string with `std::endl` */
+class lines : public responder
+{
+public:
+	virtual status_code_type run() override
+	{
+		auto query = params().get(detail::params::VARIABLE::query_string);
+
+		set_flush_on_sync(params().has("SYNC"));
+
+		output() << "Content-Type: text/plain\r\n\r\n";
+
+		for (int i = 0, count = std::atoi(std::string(query.data(), query.size()).c_str()); i < count; ++i) {
+			output() << "line " << i << std::endl;
+
+			if (params().has("FLUSH") && i == count / 2) {
+				flush();
+			}
+		}
+
+		return 0;
+	}
+};
+
+std::atomic_int authorizer_runs{ 0 };
+
+/** grants the token `good`, denies `bad` and fails for anything else */
+class token_check : public authorizer
+{
+public:
+	virtual status_code_type run() override
+	{
+		auto token = params().get(detail::params::VARIABLE::http_authorization);
+
+		++authorizer_runs;
+
+		if (token == "good") {
+			output() << "Status: 200\r\nVariable-User: user\r\n\r\n";
+		} else if (token == "bad") {
+			output() << "Status: 403\r\n\r\n";
+		} else if (token == "crash") {
+			output() << "Status: 200\r\n\r\n";
+
+			return 1;
+		} else {
+			output() << "Status: 500\r\n\r\n";
+		}
+
+		return 0;
+	}
+};
+
+std::size_t category(const memory::governor& governor, CATEGORY category)
+{
+	return governor.stats().categories[static_cast<int>(category)];
+}
+
+int soak_requests()
+{
+	auto count = std::getenv("FAST_CGI_SOAK_REQUESTS");
+
+	return count ? std::atoi(count) : 5000;
+}
+
+} // namespace
+
+TEST_CASE("a keep-alive connection does not accumulate input", "[service][soak]")
+{
+	auto governor = std::make_shared<memory::governor>(std::size_t(1) << 40);
+	test::client client(std::make_shared<test::counting_allocator>());
+	std::string input(2000, 'x');
+	const auto requests = soak_requests();
+	const auto warm_up  = std::min(requests, 200);
+	std::size_t connection_input = 0;
+	std::size_t request_input    = 0;
+
+	client.service().set_role<echo>();
+	client.service().set_governor(governor);
+	client.start();
+
+	for (int i = 0; i < requests; ++i) {
+		client.send_request(1, 1, true, { { "CONTENT_LENGTH", std::to_string(input.size()) } }, input);
+
+		auto response = client.read_response();
+
+		REQUIRE(response.protocol_status == 0);
+		REQUIRE(response.output == "Content-Type: text/plain\r\n\r\n2000");
+
+		if (i + 1 == warm_up) {
+			connection_input = category(*governor, CATEGORY::connection_input);
+			request_input    = category(*governor, CATEGORY::input);
+		}
+	}
+
+	// the consumed pages were recycled, so the memory depends on the in-flight data and not on the requests
+	CHECK(category(*governor, CATEGORY::connection_input) <= connection_input + 65536);
+	CHECK(category(*governor, CATEGORY::input) <= request_input + 65536);
+
+	client.close();
+}
+
+TEST_CASE("a keep-alive connection reuses its output pages", "[service]")
+{
+	auto governor = std::make_shared<memory::governor>(std::size_t(1) << 40);
+	test::client client(std::make_shared<test::counting_allocator>());
+	std::size_t output = 0;
+
+	client.service().set_role<echo>();
+	client.service().set_governor(governor);
+	client.start();
+
+	for (int i = 0; i < 1000; ++i) {
+		client.send_request(1, 1, true, { { "CONTENT_LENGTH", "0" } });
+
+		auto response = client.read_response();
+
+		REQUIRE(response.protocol_status == 0);
+		REQUIRE(response.output == "Content-Type: text/plain\r\n\r\n0");
+
+		if (i == 99) {
+			output = category(*governor, CATEGORY::output);
+		}
+	}
+
+	// the last page of every stream returns to the free list
+	CHECK(category(*governor, CATEGORY::output) <= output + 65536);
+
+	client.close();
+}
+
+TEST_CASE("the connection stops reading while its buffer is full", "[service]")
+{
+	constexpr std::size_t capacity = 65536;
+	auto governor                  = std::make_shared<memory::governor>(std::size_t(1) << 40);
+	test::client client(std::make_shared<test::counting_allocator>());
+	std::string data(4 << 20, 'd');
+	std::size_t peak = 0;
+
+	client.service().set_role<lazy_filter>();
+	client.service().set_governor(governor);
+	client.service().set_connection_buffer_size(capacity);
+	client.start();
+
+	filter_blocked = true;
+
+	std::thread sender([&] {
+		client.send_request(1, 3, false,
+		                    { { "CONTENT_LENGTH", "0" }, { "FCGI_DATA_LENGTH", std::to_string(data.size()) } }, {},
+		                    &data);
+	});
+
+	for (int i = 0; i < 200; ++i) {
+		peak = std::max(peak, category(*governor, CATEGORY::connection_input));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// the filter buffers a bounded amount of its data stream; the rest stays in the socket. The unread input may span
+	// one more page and up to four recycled pages are kept
+	CHECK(peak <= capacity + 5 * memory::buffer::default_max_page_size);
+	CHECK(category(*governor, CATEGORY::input) <= 2 * detail::request::filter_capacity);
+
+	filter_blocked = false;
+
+	auto response = client.read_response();
+
+	sender.join();
+
+	CHECK(response.protocol_status == 0);
+	CHECK(response.output == "Content-Type: text/plain\r\n\r\n" + std::to_string(data.size()));
+}
+
+TEST_CASE("requests of unknown or unimplemented roles are rejected", "[service]")
+{
+	test::client client(std::make_shared<test::counting_allocator>());
+
+	client.service().set_role<echo>();
+	client.start();
+
+	for (auto role : { 2, 3, 4, 0 }) {
+		client.send_request(1, role, true, {});
+
+		auto response = client.read_response();
+
+		INFO(role);
+		CHECK(response.protocol_status == 3);
+		CHECK(response.records == 1);
+	}
+
+	client.send_request(1, 1, true, { { "CONTENT_LENGTH", "0" } });
+
+	CHECK(client.read_response().protocol_status == 0);
+}
+
+TEST_CASE("the output stream and the output buffer can be mixed", "[service][output]")
+{
+	test::client client(std::make_shared<test::counting_allocator>());
+
+	client.service().set_role<mixed>();
+	client.start();
+
+	client.send_request(1, 1, true, { { "CONTENT_LENGTH", "0" } });
+
+	auto response = client.read_response();
+
+	CHECK(response.protocol_status == 0);
+	CHECK(response.output == "Content-Type: text/plain\r\n\r\n1,2,3,4.5,6,seven,8\n");
+
+	client.close();
+}
+
+TEST_CASE("small writes are coalesced into large records", "[service][output]")
+{
+	test::client client(std::make_shared<test::counting_allocator>());
+
+	client.service().set_role<lines>();
+	client.start();
+
+	auto request = [&client](const char* count, const test::params_type& more = {}) {
+		test::params_type params = { { "QUERY_STRING", count } };
+
+		params.insert(params.end(), more.begin(), more.end());
+		client.send_request(1, 1, true, params);
+
+		auto response = client.read_response();
+
+		REQUIRE(response.protocol_status == 0);
+		// the empty record ends the stream
+		REQUIRE(response.output_records.back() == 0);
+
+		response.output_records.pop_back();
+
+		return response;
+	};
+
+	SECTION("std::endl does not send a record")
+	{
+		auto response = request("10");
+
+		CHECK(response.output_records.size() == 1);
+		CHECK(response.output.find("line 9\n") != std::string::npos);
+	}
+
+	SECTION("the records grow up to the maximum size")
+	{
+		auto response = request("100000");
+
+		// the largest pages almost fill the maximum record size of 65535 bytes
+		CHECK(response.output.size() > 1000000);
+		CHECK(response.output_records.size() < 30);
+		CHECK(*std::max_element(response.output_records.begin(), response.output_records.end()) > 65000);
+	}
+
+	SECTION("an explicit flush sends a record")
+	{
+		CHECK(request("10", { { "FLUSH", "1" } }).output_records.size() == 2);
+	}
+
+	SECTION("syncing flushes on request")
+	{
+		CHECK(request("10", { { "SYNC", "1" } }).output_records.size() == 10);
+	}
+
+	client.close();
+}
+
+TEST_CASE("authorizer requests are dispatched to the authorizer", "[service][authorizer]")
+{
+	test::client client(std::make_shared<test::counting_allocator>());
+
+	client.service().set_role<token_check>();
+	client.start();
+
+	client.send_request(1, 2, true, { { "HTTP_AUTHORIZATION", "good" } });
+
+	auto response = client.read_response();
+
+	CHECK(response.protocol_status == 0);
+	CHECK(response.output == "Status: 200\r\nVariable-User: user\r\n\r\n");
+
+	client.send_request(1, 2, true, { { "HTTP_AUTHORIZATION", "bad" } });
+
+	CHECK(client.read_response().output == "Status: 403\r\n\r\n");
+
+	// only the authorizer role is implemented
+	client.send_request(1, 1, true, {});
+
+	CHECK(client.read_response().protocol_status == 3);
+}
+
+TEST_CASE("authorizer decisions are cached", "[service][authorizer]")
+{
+	auto cache = std::make_shared<response_cache>(std::vector<std::string>{ "HTTP_AUTHORIZATION" },
+	                                              std::chrono::seconds(60), std::chrono::seconds(0), 1 << 20);
+	test::client client(std::make_shared<test::counting_allocator>());
+
+	client.service().set_role<token_check>();
+	client.service().set_authorizer_cache(cache);
+	client.start();
+
+	auto authorize = [&client](const char* token) {
+		client.send_request(1, 2, true, { { "HTTP_AUTHORIZATION", token } });
+
+		auto response = client.read_response();
+
+		REQUIRE(response.protocol_status == 0);
+
+		return response;
+	};
+
+	authorizer_runs = 0;
+
+	SECTION("grants and denials")
+	{
+		for (auto token : { "good", "bad" }) {
+			auto first = authorize(token);
+			auto runs  = authorizer_runs.load();
+
+			INFO(token);
+			CHECK(runs == (token[0] == 'g' ? 1 : 2));
+
+			// the second request is answered from the cache
+			auto second = authorize(token);
+
+			CHECK(authorizer_runs == runs);
+			CHECK(second.output == first.output);
+			CHECK(second.app_status == first.app_status);
+		}
+
+		CHECK(cache->stats().hits == 2);
+		CHECK(cache->stats().misses == 2);
+		CHECK(cache->stats().entries == 2);
+	}
+
+	SECTION("errors are not stored")
+	{
+		for (auto token : { "error", "crash" }) {
+			authorize(token);
+			authorize(token);
+		}
+
+		CHECK(authorizer_runs == 4);
+		CHECK(cache->stats().hits == 0);
+		CHECK(cache->stats().entries == 0);
+	}
+
+	client.close();
+}
+
+TEST_CASE("an aborted request discards its output", "[service][abort]")
+{
+	test::client client(std::make_shared<test::counting_allocator>());
+	const char abort_request[8] = { 1, 2, 0, 1, 0, 0, 0, 0 };
+
+	client.service().set_role<streamer>();
+	client.start();
+
+	cancel_calls = 0;
+
+	// the connection serves the next request after an abort
+	for (int i = 1; i <= 2; ++i) {
+		streaming = false;
+
+		client.send_request(1, 1, true, { { "CONTENT_LENGTH", "0" } });
+		wait_for(streaming, true);
+		client.send_raw(std::string(abort_request, sizeof(abort_request)));
+
+		auto response = client.read_response();
+
+		// the output written after the abort is never sent
+		CHECK(response.protocol_status == 0);
+		CHECK(response.app_status == 1);
+		CHECK(response.output.find("cancelled") == std::string::npos);
+		CHECK(cancel_calls == i);
+	}
+
+	client.close();
+}
+
+TEST_CASE("closing the connection cancels its requests", "[service][abort]")
+{
+	test::client client(std::make_shared<test::counting_allocator>());
+
+	client.service().set_role<streamer>();
+	client.start();
+
+	cancel_calls = 0;
+	streaming    = false;
+
+	client.send_request(1, 1, true, { { "CONTENT_LENGTH", "0" } });
+	wait_for(streaming, true);
+
+	// the service waits for the cancelled role before the connection is closed
+	client.close();
+
+	CHECK(cancel_calls == 1);
+	CHECK_FALSE(streaming);
+}
\ No newline at end of file
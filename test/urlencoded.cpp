@@ -0,0 +1,244 @@
+#include <catch2/catch.hpp>
+#include <fast_cgi/urlencoded.hpp>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace fast_cgi;
+
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string>> pairs_type;
+
+int hex_value(char c)
+{
+	auto digits = std::string("0123456789abcdef");
+	auto index  = digits.find(static_cast<char>(c >= 'A' && c <= 'F' ? c - 'A' + 'a' : c));
+
+	return index == std::string::npos ? -1 : static_cast<int>(index);
+}
+
+/** decodes byte by byte */
+std::string reference_decode(const std::string& encoded)
+{
+	std::string decoded;
+
+	for (std::size_t i = 0; i < encoded.size(); ++i) {
+		if (encoded[i] == '+') {
+			decoded += ' ';
+		} else if (encoded[i] == '%' && i + 2 < encoded.size() && hex_value(encoded[i + 1]) >= 0 &&
+		           hex_value(encoded[i + 2]) >= 0) {
+			decoded += static_cast<char>(hex_value(encoded[i + 1]) << 4 | hex_value(encoded[i + 2]));
+			i += 2;
+		} else {
+			decoded += encoded[i];
+		}
+	}
+
+	return decoded;
+}
+
+/** splits at every `&` and the first `=` of a pair before decoding */
+pairs_type reference_parse(const std::string& content)
+{
+	pairs_type pairs;
+	std::size_t begin = 0;
+
+	while (begin <= content.size()) {
+		auto end = content.find('&', begin);
+
+		if (end == std::string::npos) {
+			end = content.size();
+		}
+
+		auto pair      = content.substr(begin, end - begin);
+		auto separator = pair.find('=');
+
+		if (!pair.empty()) {
+			pairs.emplace_back(reference_decode(pair.substr(0, separator)),
+			                   separator == std::string::npos ? "" : reference_decode(pair.substr(separator + 1)));
+		}
+
+		begin = end + 1;
+	}
+
+	return pairs;
+}
+
+pairs_type pairs_of(const urlencoded& parser)
+{
+	pairs_type pairs;
+
+	for (auto& pair : parser) {
+		pairs.emplace_back(std::string(pair.first.data(), pair.first.size()),
+		                   std::string(pair.second.data(), pair.second.size()));
+	}
+
+	return pairs;
+}
+
+/**
+  Creates content with few special characters, so that the vector kernels find them at every position of a block.
+ */
+std::string random_content(std::mt19937& random, std::size_t size)
+{
+	const std::string specials = "&=%+";
+	const std::string escapes  = "0123456789abcdefABCDEFxyz&=";
+	std::string content;
+
+	while (content.size() < size) {
+		auto c = random() % 40;
+
+		if (c < 4) {
+			content += specials[c];
+
+			// mostly valid escape sequences
+			if (c == 2) {
+				content += escapes[random() % escapes.size()];
+				content += escapes[random() % escapes.size()];
+			}
+		} else {
+			content += static_cast<char>('a' + c % 26);
+		}
+	}
+
+	return content;
+}
+
+} // namespace
+
+TEST_CASE("urlencoded decodes like the scalar reference", "[urlencoded]")
+{
+	std::mt19937 random(42);
+
+	CHECK(reference_decode("a%20b+c%2") == "a b c%2");
+
+	for (std::size_t size = 0; size < 200; ++size) {
+		for (int i = 0; i < 20; ++i) {
+			auto content = random_content(random, size);
+			auto decoded = content;
+
+			decoded.resize(urlencoded::decode(&decoded[0], decoded.size()));
+
+			INFO(content);
+			REQUIRE(decoded == reference_decode(content));
+		}
+	}
+}
+
+TEST_CASE("urlencoded finds special characters at every position of a block", "[urlencoded]")
+{
+	for (std::size_t length = 1; length < 100; ++length) {
+		for (auto special : { "&", "=", "%41", "+" }) {
+			for (std::size_t position = 0; position < length; ++position) {
+				std::string content(length, 'x');
+
+				content.replace(position, 1, special);
+
+				urlencoded parser;
+
+				parser.parse(content);
+
+				INFO(content);
+				REQUIRE(pairs_of(parser) == reference_parse(content));
+			}
+		}
+	}
+}
+
+TEST_CASE("urlencoded splits pairs like the scalar reference", "[urlencoded]")
+{
+	std::mt19937 random(7);
+
+	CHECK(reference_parse("a=1&&b&=2&c=d=e") ==
+	      pairs_type{ { "a", "1" }, { "b", "" }, { "", "2" }, { "c", "d=e" } });
+
+	for (std::size_t size = 0; size < 300; ++size) {
+		for (int i = 0; i < 10; ++i) {
+			auto content = random_content(random, size);
+			urlencoded parser;
+
+			parser.parse(content);
+
+			INFO(content);
+			REQUIRE(pairs_of(parser) == reference_parse(content));
+		}
+	}
+}
+
+TEST_CASE("urlencoded parses streams", "[urlencoded]")
+{
+	std::mt19937 random(3);
+	auto content = random_content(random, 100000);
+	std::istringstream input(content);
+	urlencoded parser;
+
+	parser.parse(input);
+
+	CHECK(pairs_of(parser) == reference_parse(content));
+
+	// parsing again replaces the pairs
+	parser.parse("name=first&name=second&other");
+
+	CHECK(parser.size() == 3);
+	CHECK(parser.has("other"));
+	CHECK_FALSE(parser.has("missing"));
+	CHECK(parser["name"] == "first");
+	CHECK(parser["other"].empty());
+	CHECK_THROWS_AS(parser["missing"], std::out_of_range);
+}
+
+TEST_CASE("urlencoded is faster than the scalar reference", "[urlencoded][!benchmark]")
+{
+	std::mt19937 random(1);
+	auto form  = random_content(random, 1 << 16);
+	auto query = std::string("page=2&sort=name&filter=a%20b&q=fast+cgi&lang=en");
+	std::string text;
+
+	// mostly plain text as in form fields
+	while (text.size() < (1 << 16)) {
+		text += "the+quick+brown+fox+jumps+over+the+lazy+dog%21+";
+	}
+
+	BENCHMARK("decoding text with the reference")
+	{
+		return reference_decode(text).size();
+	};
+
+	BENCHMARK("decoding text")
+	{
+		auto copy = text;
+
+		return urlencoded::decode(&copy[0], copy.size());
+	};
+
+	BENCHMARK("parsing a form with the reference")
+	{
+		return reference_parse(form).size();
+	};
+
+	BENCHMARK("parsing a form")
+	{
+		urlencoded parser;
+
+		parser.parse(form);
+
+		return parser.size();
+	};
+
+	BENCHMARK("parsing a query string with the reference")
+	{
+		return reference_parse(query).size();
+	};
+
+	BENCHMARK("parsing a query string")
+	{
+		urlencoded parser;
+
+		parser.parse(query);
+
+		return parser.size();
+	};
+}
\ No newline at end of file